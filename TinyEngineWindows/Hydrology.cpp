@@ -1,14 +1,22 @@
 #include "TinyEngine.h"
 #include <noise/noise.h>
-#include "source/world.h" //Model
+#include "source/scene.h" //Model and Rendering
 #undef main
 int main(int argc, char* args[]) {
 
-	if (argc == 2)
+	//A World Snapshot (see archive.h) or a Seed and Size
+	bool snapshot = (argc >= 2 && Archive::probe(args[1]));
+	if (snapshot && !world.load(args[1]))
+		return 1;
+	if (!snapshot && argc >= 2)
 		world.SEED = std::stoi(args[1]);
+	if (!snapshot && argc >= 3)
+		world.dim = glm::ivec2(std::stoi(args[2]));
 	
-	//Generate the World
-	world.generate();
+	//Generate the World and start the Simulation Thread (Paused)
+	if (!snapshot) world.generate();
+	viewPos = glm::vec3(world.dim.x / 2.0, world.scale / 2.0, world.dim.y / 2.0);
+	simulation.start();
 
 	//Initialize the Visualization
 	Tiny::init("River Systems Simulator", WIDTH, HEIGHT);
@@ -16,15 +24,20 @@ int main(int argc, char* args[]) {
 	//Setup Shaders
 	Shader shader("source/shader/default.vs", "source/shader/default.fs", { "in_Position", "in_Normal", "in_Color" });
 	Shader depth("source/shader/depth.vs", "source/shader/depth.fs", { "in_Position" });
+	Shader gridshader("source/shader/terrain.vs", "source/shader/terrain.fs", { "in_Height", "in_Normal", "in_Color" });
+	Shader griddepth("source/shader/terraindepth.vs", "source/shader/depth.fs", { "in_Height" });
+	Shader displace("source/shader/displace.vs", "source/shader/terrain.fs", {});
+	Shader displacedepth("source/shader/displacedepth.vs", "source/shader/depth.fs", {});
 	Shader effect("source/shader/effect.vs", "source/shader/effect.fs", { "in_Quad", "in_Tex" });
 	Shader billboard("source/shader/billboard.vs", "source/shader/billboard.fs", { "in_Quad", "in_Tex" });
 
 	//Particle System Shaders
-	Shader sprite("source/shader/sprite.vs", "source/shader/sprite.fs", { "in_Quad", "in_Tex", "in_Model" });
-	Shader spritedepth("source/shader/spritedepth.vs", "source/shader/spritedepth.fs", { "in_Quad", "in_Tex", "in_Model" });
+	Shader sprite("source/shader/sprite.vs", "source/shader/sprite.fs", { "in_Quad", "in_Tex", "in_Instance" });
+	Shader spritedepth("source/shader/spritedepth.vs", "source/shader/spritedepth.fs", { "in_Quad", "in_Tex", "in_Instance" });
 
-	//Trees as a Particle System
-	Particle trees;
+	//Trees as instanced Sprites, updated by changed Slots
+	Sprites trees;
+	Forest forest;
 	Texture tree(image::load("resource/Tree.png"));
 	Texture treenormal(image::load("resource/TreeNormal.png"));
 
@@ -34,23 +47,75 @@ int main(int argc, char* args[]) {
 
 	//Setup 2D Images
 	Billboard map(world.dim.x, world.dim.y, false); //Render target for automata
-	map.raw(image::make<double>(world.dim, world.waterpath, world.waterpool, hydromap));
+	Texture mapimage;                 //Minimap Colors, updated by dirty Rows
+	std::vector<GLubyte> pixels;      //Persistent RGBA Buffer of the Minimap
+	bool mapstale = false;            //Hidden while the World changed
+	minimap(mapimage, simulation.current(), true, pixels);
+	plant(trees, forest, simulation.current());  //Trees of a loaded World
 
-	//Setup World Model
-	Model model(constructor);
-	model.translate(-viewPos);
+	//Setup World Model (Quad Mesh, Grid or Field Textures, built in the Loop)
+	Model model;
+	Grid terrain;
+	Texture fields[3];                //Height, Pool and Path
+	int built = -1;
+
+	//Chunk Patches: one Index Strip per Level, the same for every Map
+	Chunks chunks;
+	std::vector<Chunks::Patch> patches;
+	Grid levels[Chunks::LEVELS];
+	for (int l = 0; l < Chunks::LEVELS; l++)
+		levels[l].construct([l](Grid* g) { strip(g, glm::ivec2(Chunks::side(l))); });
+
+	//Draw the visible Chunks of the Displaced Terrain
+	auto drawChunks = [&](Shader& s, glm::mat4 mvp, float pixels, float scale) {
+		const char* names[3] = { "heightmap", "waterpool", "waterpath" };
+		for (int k = 0; k < 3; k++) {
+			glActiveTexture(GL_TEXTURE0 + 1 + k);
+			glBindTexture(GL_TEXTURE_2D, fields[k].texture);
+			s.setInt(names[k], 1 + k);
+		}
+		s.setFloat("scale", scale);
+
+		chunks.select(mvp, pixels, patches);
+		glDisable(GL_CULL_FACE);        //Skirts face both Ways
+		for (auto& p : patches) {
+			s.setVec2("origin", glm::vec2(p.origin));
+			s.setInt("step", 1 << p.level);
+			s.setInt("cols", Chunks::side(p.level));
+			s.setFloat("skirt", p.skirt);
+			levels[p.level].render();
+		}
+		glEnable(GL_CULL_FACE);
+	};
 
 	//Visualization Hooks
 	Tiny::event.handler = eventHandler;
 	Tiny::view.interface = []() {};
 	Tiny::view.pipeline = [&]() {
 
+		//Front Snapshot of the Simulation
+		Snapshot<scalar>& view = simulation.current();
+
 		//Render Shadowmap
 		shadow.target();                  //Prepare Target
-		depth.use();                      //Prepare Shader
 		model.model = glm::translate(glm::mat4(1.0), -viewPos);
-		depth.setMat4("dmvp", depthProjection * depthCamera * model.model);
-		model.render(GL_TRIANGLES);       //Render Model
+		terrain.model = model.model;
+		if (meshing == DISPLACE) {
+			displacedepth.use();            //Prepare Shader
+			displacedepth.setMat4("dmvp", depthProjection * depthCamera * model.model);
+			drawChunks(displacedepth, depthProjection * depthCamera * model.model, depthProjection[0][0] * shadow.WIDTH / 2.0f, view.scale);
+		}
+		else if (meshing == GRID) {
+			griddepth.use();                //Prepare Shader
+			griddepth.setInt("cols", terrain.dim.y);
+			griddepth.setMat4("dmvp", depthProjection * depthCamera * terrain.model);
+			terrain.render();               //Render Grid
+		}
+		else {
+			depth.use();                    //Prepare Shader
+			depth.setMat4("dmvp", depthProjection * depthCamera * model.model);
+			model.render(GL_TRIANGLES);     //Render Model
+		}
 
 		//We want the Model to Face the Light!
 		float rot = acos(glm::dot(glm::vec3(1, 0, 0), glm::normalize(glm::vec3(lightPos.x, 0, lightPos.z))));
@@ -59,60 +124,46 @@ int main(int argc, char* args[]) {
 		glm::mat4 faceLight = glm::rotate(glm::mat4(1.0), rot - glm::radians(45.0f), glm::vec3(0.0, 1.0, 0.0));
 
 		//Tree Shadows
-		if (!world.trees.empty()) {
-
-			//Update the Tree Particle System
-			trees.models.clear();
-			for (auto& t : world.trees) {
-				glm::vec3 tpos = glm::vec3(t.pos.x, t.size + world.scale*world.heightmap[t.index], t.pos.y);
-				glm::mat4 model = glm::translate(glm::mat4(1.0), tpos - viewPos);
-				model = glm::rotate(model, rot, glm::vec3(0.0, 1.0, 0.0)); //Face Camera
-				model = glm::scale(model, glm::vec3(t.size));
-				trees.models.push_back(model);
-			}
-			trees.update();
-
-			//Render the Trees as a Particle System
+		if (!view.trees.empty()) {
 			spritedepth.use();
 			glActiveTexture(GL_TEXTURE0 + 0);
 			glBindTexture(GL_TEXTURE_2D, tree.texture);
 			spritedepth.setInt("spriteTexture", 0);
 			spritedepth.setMat4("projectionCamera", depthProjection*depthCamera);
+			spritedepth.setMat4("model", model.model);
+			spritedepth.setFloat("facing", rot);  //Face the Light
 			trees.render();
 		}
 
 		//Regular Image
 		image.target(skyCol);           //Prepare Target
-		shader.use();                   //Prepare Shader
+		Shader& ground = (meshing == DISPLACE) ? displace : (meshing == GRID) ? gridshader : shader;
+		ground.use();                   //Prepare Shader
 		glActiveTexture(GL_TEXTURE0 + 0);
 		glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
-		shader.setInt("shadowMap", 0);
-		shader.setVec3("lightCol", lightCol);
-		shader.setVec3("lightPos", lightPos);
-		shader.setVec3("lookDir", lookPos - cameraPos);
-		shader.setFloat("lightStrength", lightStrength);
-		shader.setMat4("projectionCamera", projection * camera);
-		shader.setMat4("dbmvp", biasMatrix * depthProjection * depthCamera * glm::mat4(1.0f));
-		shader.setMat4("model", model.model);
-		shader.setVec3("flatColor", flatColor);
-		shader.setVec3("steepColor", steepColor);
-		shader.setFloat("steepness", steepness);
-		model.render(GL_TRIANGLES);    //Render Model
+		ground.setInt("shadowMap", 0);
+		ground.setVec3("lightCol", lightCol);
+		ground.setVec3("lightPos", lightPos);
+		ground.setVec3("lookDir", lookPos - cameraPos);
+		ground.setFloat("lightStrength", lightStrength);
+		ground.setMat4("projectionCamera", projection * camera);
+		ground.setMat4("dbmvp", biasMatrix * depthProjection * depthCamera * glm::mat4(1.0f));
+		ground.setMat4("model", model.model);
+		ground.setVec3("flatColor", flatColor);
+		ground.setVec3("steepColor", steepColor);
+		ground.setFloat("steepness", steepness);
+		if (meshing == DISPLACE) {
+			ground.setVec3("waterColor", waterColor);
+			drawChunks(ground, projection * camera * model.model, projection[0][0] * image.WIDTH / 2.0f, view.scale);
+		}
+		else if (meshing == GRID) {
+			ground.setInt("cols", terrain.dim.y);
+			terrain.render();             //Render Grid
+		}
+		else model.render(GL_TRIANGLES); //Render Model
 
 		//Render the Trees
-		if (!world.trees.empty()) {
-
-			//Update the Tree Particle System
-			trees.models.clear();
-			for (auto& t : world.trees) {
-				glm::vec3 tpos = glm::vec3(t.pos.x, t.size + world.scale*world.heightmap[t.index], t.pos.y);
-				glm::mat4 model = glm::translate(glm::mat4(1.0), tpos - viewPos);
-				model = glm::rotate(model, -glm::radians(rotation - 45.0f), glm::vec3(0.0, 1.0, 0.0)); //Face Camera
-				model = glm::scale(model, glm::vec3(t.size));
-				trees.models.push_back(model);
-			}
-			trees.update();
-
+		if (!view.trees.empty()) {
 			sprite.use();
 			glActiveTexture(GL_TEXTURE0 + 0);
 			glBindTexture(GL_TEXTURE_2D, tree.texture);
@@ -121,6 +172,8 @@ int main(int argc, char* args[]) {
 			glBindTexture(GL_TEXTURE_2D, treenormal.texture);
 			sprite.setInt("normalTexture", 1);
 			sprite.setMat4("projectionCamera", projection*camera);
+			sprite.setMat4("model", model.model);
+			sprite.setFloat("facing", -glm::radians(rotation - 45.0f));  //Face the Camera
 			sprite.setMat4("faceLight", faceLight);
 			sprite.setVec3("lightPos", lightPos);
 			glm::mat4 M = glm::rotate(glm::mat4(1.0), glm::radians(rotation - 45.0f), glm::vec3(0.0, 1.0, 0.0));
@@ -146,7 +199,7 @@ int main(int argc, char* args[]) {
 			billboard.use();
 			glActiveTexture(GL_TEXTURE0 + 0);
 
-			glBindTexture(GL_TEXTURE_2D, map.texture);
+			glBindTexture(GL_TEXTURE_2D, mapimage.texture);
 			map.move(glm::vec2(0.0, 0.8), glm::vec2(0.2));
 			billboard.setMat4("model", map.model);
 			map.render();
@@ -157,19 +210,49 @@ int main(int argc, char* args[]) {
 
 	//Define a World Mesher?
 
+	std::vector<glm::ivec2> ranges; //Rewritten Vertex Ranges
+	std::vector<GLfloat> rows;      //Staged Texture Rows
+
 	Tiny::loop([&]() {
-		//Do Erosion Cycles!
-		if (!paused) {
-			//Erode the World and Update the Model
-			world.erode(256);
-			world.grow();
-			model.construct(constructor); //Reconstruct Updated Model
-
-			//Redraw the Path and Death Image
-			if (viewmap)
-				map.raw(image::make<double>(world.dim, world.waterpath, world.waterpool, hydromap));
+		//Newest Snapshot of the Simulation Thread (Erodes on its own)
+		Snapshot<scalar>* view = simulation.poll();
+		bool full = (built != meshing); //Switched: the new Mesh is stale
+		built = meshing;
+		if (full && view == NULL)
+			view = &simulation.current();
+
+		if (view != NULL) {
+			full = full || view->full;
+			if (meshing == DISPLACE) {
+				upload(fields, *view, full, rows); //Dirty Rows to the Field Textures
+				chunks.update(*view, full);     //Bounds and Errors of the Chunks
+			}
+			else if (meshing == GRID && full)
+				terrain.construct(gridder);   //Reconstruct Updated Grid
+			else if (meshing == GRID) {
+				regrid(&terrain, *view, ranges); //Only the Changed Rows
+				for (auto& r : ranges)
+					terrain.update(r.x, r.y);
+			}
+			else if (full)
+				model.construct(constructor); //Reconstruct Updated Model
+			else {
+				remesh(&model, *view, ranges);
+				for (auto& r : ranges)
+					model.update(r.x, r.y);
+			}
+			plant(trees, forest, *view);      //Changed Tree Slots
+		}
+
+		//Redraw the Path and Pool Image: dirty Rows, or all once it shows again
+		if (viewmap && (view != NULL || mapstale)) {
+			minimap(mapimage, (view != NULL) ? *view : simulation.current(), full || mapstale, pixels);
+			mapstale = false;
 		}
+		else if (!viewmap && view != NULL)
+			mapstale = true;
 		});
 
+	simulation.stop();
 	return 0;
 }
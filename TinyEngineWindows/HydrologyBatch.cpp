@@ -0,0 +1,160 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <chrono>
+#include <glm/glm.hpp>
+#include <noise/noise.h>
+#include "include/helpers/helper.h"
+#include "include/helpers/field.h"
+#include "include/helpers/parallel.h"
+#include "source/world.h" //Model only: no SDL, OpenGL or ImGUI
+#include "source/export.h"
+
+/*
+	Headless Batch Tool: generates and erodes a world at full speed and writes
+	its fields (see export.h) to PREFIX.height, PREFIX.pool, PREFIX.path and
+	PREFIX.plants with the extension of the format: .raw (default) for raw
+	little-endian float32 grids, row after row without the field padding
+	(dim.x rows of dim.y values), .png for 16-bit gray images scaled to the
+	range of each field, or one tiled float image PREFIX.exr with a channel
+	per field (-format raw|png|exr).
+
+	A cycle is one frame of the interactive loop: erode with DROPS particles,
+	then grow the vegetation. With -stats FILE the erosion counters of every
+	cycle are written to FILE, as JSON if it ends in .json, else as CSV.
+
+	-load FILE continues from a world snapshot instead of generating one (SEED
+	and SIZE are then ignored). -save FILE writes a snapshot after the last
+	cycle, and with -checkpoint N also after every N cycles (see archive.h).
+
+	-scratch PREFIX keeps the fields in scratch files PREFIX.N instead of
+	memory, for maps larger than memory; they are removed on exit.
+
+	-roots R spreads the plant density of a tree over R cells around it
+	(default 1, see vegetation.h).
+
+	-nocache computes every surface normal instead of caching them, which
+	saves 12 bytes per cell (see World::features).
+*/
+
+template<typename T>
+bool write(std::string prefix, std::string format, World<T>& world) {
+	std::vector<exporter::Channel<T>> channels = {
+		{"height", &world.heightmap},
+		{"pool", &world.waterpool},
+		{"path", &world.waterpath.bake()},
+		{"plants", &world.plantdensity}
+	};
+	if (format == "exr")
+		return exporter::exr(prefix + ".exr", channels, world.threads);
+
+	for (auto& c : channels) {
+		std::string file = prefix + "." + c.name + "." + format;
+		bool ok = (format == "png") ?
+			exporter::png(file, *c.field, exporter::range(*c.field, world.threads), world.threads) :
+			exporter::raw(file, *c.field, world.threads);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+int usage() {
+	std::cout << "Usage: HydrologyBatch SEED SIZE CYCLES PREFIX [-drops N] [-tiled THREADS] [-packed] [-basins] [-spillmap] [-stats FILE] [-load FILE] [-save FILE] [-checkpoint N] [-scratch PREFIX] [-roots R] [-nocache] [-format raw|png|exr]" << std::endl;
+	return 1;
+}
+
+int main(int argc, char* args[]) {
+
+	if (argc < 5)
+		return usage();
+
+	World<scalar> world;
+	world.SEED = std::stoi(args[1]);
+	world.dim = glm::ivec2(std::stoi(args[2]));
+	int cycles = std::stoi(args[3]);
+	std::string prefix = args[4];
+	int drops = 256;
+	std::string statsfile;
+	std::string loadfile, savefile;
+	int checkpoint = 0;
+	std::string format = "raw";
+
+	//Erosion Options (Same as the Interactive Toggles)
+	for (int i = 5; i < argc; i++) {
+		if (!strcmp(args[i], "-drops") && i + 1 < argc) drops = std::stoi(args[++i]);
+		else if (!strcmp(args[i], "-tiled") && i + 1 < argc) {
+			world.tiled = true;
+			world.threads = std::stoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-packed")) world.packed = true;
+		else if (!strcmp(args[i], "-basins")) world.basins = true;
+		else if (!strcmp(args[i], "-spillmap")) world.spillmap = true;
+		else if (!strcmp(args[i], "-stats") && i + 1 < argc) {
+			world.counting = true;
+			statsfile = args[++i];
+		}
+		else if (!strcmp(args[i], "-load") && i + 1 < argc) loadfile = args[++i];
+		else if (!strcmp(args[i], "-save") && i + 1 < argc) savefile = args[++i];
+		else if (!strcmp(args[i], "-checkpoint") && i + 1 < argc) checkpoint = std::stoi(args[++i]);
+		else if (!strcmp(args[i], "-scratch") && i + 1 < argc) world.scratchfile = args[++i];
+		else if (!strcmp(args[i], "-roots") && i + 1 < argc) world.roots.reach(std::stoi(args[++i]));
+		else if (!strcmp(args[i], "-nocache")) world.normalcache = false;
+		else if (!strcmp(args[i], "-format") && i + 1 < argc) {
+			format = args[++i];
+			if (format != "raw" && format != "png" && format != "exr") return usage();
+		}
+		else return usage();
+	}
+
+	//Generate or Load the World
+	if (loadfile.empty()) world.generate();
+	else if (!world.load(loadfile)) return 1;
+
+	//Counters are written as every Call finishes
+	std::ofstream statsout;
+	std::unique_ptr<Stats::Log> log;
+	if (world.counting) {
+		statsout.open(statsfile);
+		bool json = statsfile.size() >= 5 && statsfile.compare(statsfile.size() - 5, 5, ".json") == 0;
+		log.reset(new Stats::Log(statsout, json));
+		world.log = [&](const Stats& s) { log->write(s); };
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < cycles; i++) {
+		world.erode(drops);
+		world.grow();
+		if (!savefile.empty() && checkpoint > 0 && (i + 1) % checkpoint == 0 && i + 1 < cycles)
+			if (!world.save(savefile)) return 1;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << cycles << " cycles in " << elapsed.count() << "s" << std::endl;
+
+	//Write the Fields
+	start = std::chrono::steady_clock::now();
+	if (!write(prefix, format, world)) {
+		std::cout << "Failed to write " << prefix << ".*" << std::endl;
+		return 1;
+	}
+	elapsed = std::chrono::steady_clock::now() - start;
+
+	if (!savefile.empty()) {
+		if (!world.save(savefile)) return 1;
+		std::cout << "Saved World to " << savefile << std::endl;
+	}
+
+	//Close the Counters
+	if (log) {
+		log->close();
+		if (!statsout) {
+			std::cout << "Failed to write " << statsfile << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "Wrote " << world.dim.x << "x" << world.dim.y << " fields to " << prefix << ".* (" << format << ") in " << elapsed.count() << "s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,298 @@
+#include "TinyEngine.h"
+#include <noise/noise.h>
+#include "source/scene.h" //Model and Mesher, no Window is opened
+#include "source/export.h"
+#include <algorithm>
+
+/*
+	Benchmark Suite for the Hot Paths: every case runs on fixed seeds for each
+	map size and both scalar types, is repeated REPS times on a fresh copy of
+	the same world, and reports the median and fastest run.
+
+	A case does ITEMS units of work per run (cells, drops, steps, calls),
+	reported as items per second. ns/cell divides the median run by the cells
+	of the map. Every case also reports the memory of the world after its
+	last run (World::bytes), which tells float from double and shows what the
+	optional features cost. Results go to stdout (or -out FILE) as CSV, or as
+	JSON with -json; all other output of the simulation is muted.
+
+	Erosion cases start from a world pre-eroded for WARMUP cycles, so there
+	are pools, streams and trees to work on. Descend and erode count descend
+	steps (see stats.h), since the steps per drop change with the world.
+	Erode takes them from an untimed run with World::counting on, and times
+	runs with it off, since the counters read the clock around every phase.
+*/
+
+struct Result {
+	std::string name, type;
+	int size, reps;
+	long items;
+	double median, best;  //Seconds per Run
+	size_t bytes;         //World Memory after the last Run
+};
+
+struct Mesh {   //Vertex Vectors of a Model, without GL Buffers
+	std::vector<GLfloat> positions, normals, colors;
+	std::vector<GLuint> indices;
+};
+
+struct Packed { //Vertices of a Grid, without GL Buffers
+	glm::ivec2 dim = glm::ivec2(0);
+	std::vector<Grid::Vertex> vertices;
+	std::vector<GLuint> indices;
+};
+
+int REPS = 5;
+int WARMUP = 100;
+const int SEED = 42;
+const int DROPS = 256;
+
+std::ostream* output = &std::cout;
+std::vector<Result> results;
+
+//Time a Case on World w: setup() is untimed, run() is timed and returns its Items
+template<typename T, typename S, typename F>
+void measure(std::string name, std::string type, int size, const World<T>& w, S setup, F run) {
+	std::vector<double> times;
+	long items = 0;
+	for (int r = 0; r < REPS; r++) {
+		setup();
+		auto start = std::chrono::high_resolution_clock::now();
+		items = run();
+		std::chrono::duration<double> d = std::chrono::high_resolution_clock::now() - start;
+		times.push_back(d.count());
+	}
+	std::sort(times.begin(), times.end());
+	results.push_back({ name, type, size, REPS, items, times[times.size() / 2], times[0], w.bytes() });
+}
+
+template<typename T>
+void suite(std::string type, int size) {
+
+	World<T> base;
+	base.SEED = SEED;
+	base.dim = glm::ivec2(size);
+	base.generate();
+
+	World<T> w;
+	auto fresh = [&]() { w = base; };
+
+	//World::generate
+	measure("generate", type, size, w, fresh, [&]() {
+		w.generate();
+		return (long)size * size;
+	});
+
+	//Erode and grow the Base for the other Cases (World::generator is seeded by generate)
+	for (int i = 0; i < WARMUP; i++) {
+		base.erode(DROPS);
+		base.grow();
+	}
+
+	//Drop::descend (Drops are spawned from a fixed Seed), Items are Steps
+	std::vector<Drop<T>> drops;
+	auto spawn = [&]() {
+		w = base;
+		srand(SEED);
+		drops.clear();
+		for (int i = 0; i < DROPS; i++)
+			drops.emplace_back(glm::vec2(rand() % size, rand() % size));
+	};
+	Stats stats;
+	measure("descend", type, size, w, [&]() { spawn(); stats = Stats(); }, [&]() {
+		for (auto& d : drops)
+			d.descend(w.heightmap, w.normals, w.waterpath, w.waterpool, w.track, w.plantdensity, w.scale, NULL, NULL, &stats);
+		return stats.steps;
+	});
+
+	//The same Drops in SIMD Packets (see packet.h), a Lane is refilled when it stops
+	if (DropPacket<T>::SIMD) {
+		measure("descend/packed", type, size, w, [&]() { spawn(); stats = Stats(); }, [&]() {
+			DropPacket<T> packet;
+			size_t next = 0;
+			while (true) {
+				for (int l = 0; l < DropPacket<T>::N; l++)
+					if (!packet.active(l) && next < drops.size())
+						packet.load(l, drops[next++]);
+				if (!packet.live) break;
+				packet.step(w.heightmap, w.normals, w.waterpath, w.waterpool, w.track, w.plantdensity, w.scale, NULL, NULL, NULL, &stats);
+			}
+			return stats.steps;
+		});
+	}
+
+	//Drop::flood, from where Drops stopped descending with Volume left
+	auto descended = [&]() {
+		w = base;
+		srand(SEED);
+		drops.clear();
+		for (int i = 0; i < 64 * DROPS && (int)drops.size() < DROPS; i++) {
+			Drop<T> d(glm::vec2(rand() % size, rand() % size));
+			d.descend(w.heightmap, w.normals, w.waterpath, w.waterpool, w.track, w.plantdensity, w.scale);
+			if (d.volume > d.minVol)
+				drops.push_back(d);
+		}
+	};
+	measure("flood", type, size, w, descended, [&]() {
+		for (auto& d : drops)
+			d.flood(w.heightmap, w.waterpool);
+		return (long)drops.size();
+	});
+
+	//World::erode in each Mode, from a Copy of the Base that ran one Call in
+	//that Mode, so Lake Registry and Depression Map are built. Items are Steps
+	//of the same Call, counted once untimed.
+	auto erosion = [&](std::string name, std::function<void(World<T>&)> set) {
+		World<T> moded = base;
+		set(moded);
+		moded.erode(DROPS);
+		w = moded;
+		w.counting = true;
+		w.erode(DROPS);
+		const long steps = w.stats.steps;
+		measure(name, type, size, w, [&]() { w = moded; w.counting = false; }, [&]() {
+			w.erode(DROPS);
+			return steps;
+		});
+	};
+	erosion("erode", [](World<T>&) {});
+	erosion("erode/tiled", [](World<T>& m) { m.tiled = true; });
+	if (DropPacket<T>::SIMD) erosion("erode/packed", [](World<T>& m) { m.packed = true; });
+	erosion("erode/basins", [](World<T>& m) { m.basins = true; });
+	erosion("erode/spillmap", [](World<T>& m) { m.spillmap = true; });
+
+	//World::grow
+	measure("grow", type, size, w, fresh, [&]() {
+		for (int i = 0; i < 100; i++)
+			w.grow();
+		return 100L;
+	});
+
+	//surfaceNormal, uncached, over all Cells off the Edge
+	volatile float sink = 0.0f;
+	measure("surfaceNormal", type, size, w, fresh, [&]() {
+		float sum = 0.0f;
+		for (int x = 1; x < size - 1; x++)
+			for (int y = 1; y < size - 1; y++)
+				sum += surfaceNormal(w.heightmap.index(glm::ivec2(x, y)), w.heightmap, w.scale).y;
+		sink = sum;
+		return (long)(size - 2) * (size - 2);
+	});
+
+	//Mesh Constructor
+	Mesh m;
+	measure("constructor", type, size, w, fresh, [&]() {
+		mesh(&m, w);
+		return (long)size * size;
+	});
+
+	//Shared-Vertex Grid (Strip Indices are built once per Size)
+	Packed g;
+	measure("grid", type, size, w, fresh, [&]() {
+		grid(&g, w);
+		return (long)size * size;
+	});
+
+	//image::make of the Hydrology Map
+	std::function<glm::vec4(T, T)> handle = [](T a, T b) { return hydromap(a, b); };
+	measure("image::make", type, size, w, fresh, [&]() {
+		SDL_Surface* s = image::make<T>(w.waterpath.bake(), w.waterpool, handle);
+		SDL_FreeSurface(s);
+		return (long)size * size;
+	});
+
+	//Minimap Kernel over all Rows (Persistent Buffer, see scene.h)
+	std::vector<GLubyte> pixels((size_t)size * size * 4);
+	measure("colorize", type, size, w, fresh, [&]() {
+		Field<T>& path = w.waterpath.bake();
+		for (int x = 0; x < size; x++)
+			colorize(path, w.waterpool, x, &pixels[(size_t)x * size * 4]);
+		return (long)size * size;
+	});
+
+	//Field Export (to a scratch File in the working Directory)
+	const std::string file = "HydrologyBench.export";
+	measure("exporter::png", type, size, w, fresh, [&]() {
+		exporter::png(file, w.heightmap, glm::vec2(0, 1));
+		return (long)size * size;
+	});
+	measure("exporter::exr", type, size, w, fresh, [&]() {
+		exporter::exr<T>(file, { {"height", &w.heightmap}, {"path", &w.waterpath.bake()}, {"pool", &w.waterpool} });
+		return (long)size * size;
+	});
+	std::remove(file.c_str());
+}
+
+void write(bool json) {
+	std::ostream& out = *output;
+	if (json) out << "[" << std::endl;
+	else out << "name,type,size,reps,items,median_s,best_s,items_per_s,ns_per_cell,world_bytes,bytes_per_cell" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++) {
+		Result& r = results[i];
+		double rate = r.items / r.median;
+		double ns = 1E9 * r.median / ((double)r.size * r.size);
+		double bpc = r.bytes / ((double)r.size * r.size);
+		if (json) {
+			out << "  {\"name\": \"" << r.name << "\", \"type\": \"" << r.type << "\", \"size\": " << r.size
+				<< ", \"reps\": " << r.reps << ", \"items\": " << r.items << ", \"median_s\": " << r.median
+				<< ", \"best_s\": " << r.best << ", \"items_per_s\": " << rate << ", \"ns_per_cell\": " << ns
+				<< ", \"world_bytes\": " << r.bytes << ", \"bytes_per_cell\": " << bpc
+				<< "}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+		}
+		else {
+			out << r.name << "," << r.type << "," << r.size << "," << r.reps << "," << r.items << ","
+				<< r.median << "," << r.best << "," << rate << "," << ns << "," << r.bytes << "," << bpc << std::endl;
+		}
+	}
+	if (json) out << "]" << std::endl;
+}
+
+int usage() {
+	std::cerr << "Usage: HydrologyBench [-sizes 128,256,512] [-reps N] [-warmup CYCLES] [-json] [-out FILE]" << std::endl;
+	return 1;
+}
+
+int main(int argc, char* args[]) {
+
+	std::vector<int> sizes = { 128, 256, 512 };
+	bool json = false;
+	std::ofstream file;
+
+	for (int i = 1; i < argc; i++) {
+		std::string a = args[i];
+		if (a == "-sizes" && i + 1 < argc) {
+			sizes.clear();
+			std::stringstream list(args[++i]);
+			std::string s;
+			while (std::getline(list, s, ','))
+				sizes.push_back(std::stoi(s));
+		}
+		else if (a == "-reps" && i + 1 < argc) REPS = std::max(1, std::stoi(args[++i]));
+		else if (a == "-warmup" && i + 1 < argc) WARMUP = std::stoi(args[++i]);
+		else if (a == "-json") json = true;
+		else if (a == "-out" && i + 1 < argc) {
+			file.open(args[++i]);
+			if (!file) return usage();
+			output = &file;
+		}
+		else return usage();
+	}
+
+	//Mute the Simulation, Results keep the real Stream
+	std::ostringstream mute;
+	std::streambuf* console = std::cout.rdbuf(mute.rdbuf());
+	std::ostream terminal(console);
+	if (output == &std::cout) output = &terminal;
+
+	for (auto& size : sizes) {
+		std::cerr << "Size " << size << std::endl;
+		suite<float>("float", size);
+		suite<double>("double", size);
+		mute.str("");
+	}
+
+	write(json);
+	std::cout.rdbuf(console);
+	return 0;
+}
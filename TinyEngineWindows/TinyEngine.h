@@ -33,8 +33,10 @@ using slist = std::initializer_list<std::string>;
 #include "include/helpers/ease.h"
 #include "include/helpers/color.h"
 #include "include/helpers/draw.h"
+#include "include/helpers/field.h"
 #include "include/helpers/image.h"
 #include "include/helpers/timer.h"
+#include "include/helpers/parallel.h"
 
 //Utility Classes for the Engine
 //#include "include/utility/texture.cpp"
@@ -213,6 +215,7 @@ public:
 
 	void setup();
 	void update();
+	void update(size_t first, size_t count);   //Rewrite a Vertex Range in place
 	void construct(std::function<void(Model* m)> constructor) {
 		positions.clear();  //Clear all Data
 		normals.clear();
@@ -258,6 +261,17 @@ void Model::update() {
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
 }
 
+void Model::update(size_t first, size_t count) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);      //Positions
+	glBufferSubData(GL_ARRAY_BUFFER, 3 * first * sizeof(GLfloat), 3 * count * sizeof(GLfloat), &positions[3 * first]);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);      //Normals
+	glBufferSubData(GL_ARRAY_BUFFER, 3 * first * sizeof(GLfloat), 3 * count * sizeof(GLfloat), &normals[3 * first]);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo[2]);      //Colors
+	glBufferSubData(GL_ARRAY_BUFFER, 4 * first * sizeof(GLfloat), 4 * count * sizeof(GLfloat), &colors[4 * first]);
+}
+
 void Model::translate(const glm::vec3 &axis) {
 	model = glm::translate(model, axis);
 	pos += axis;
@@ -272,6 +286,83 @@ void Model::render(GLenum T) {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	glDrawElements(T, indices.size(), GL_UNSIGNED_INT, 0);
 }
+class Grid {
+public:
+	struct Vertex {
+		GLfloat height;         //Position from the Index (see terrain.vs)
+		GLshort normal[2];      //Octahedral Normal
+		GLubyte color[4];
+	};
+
+	Grid() { setup(); };
+
+	Grid(std::function<void(Grid* g)> c) {
+		setup();
+		construct(c);
+	};
+
+	~Grid() {
+		glDisableVertexAttribArray(vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ibo);
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	glm::ivec2 dim = glm::ivec2(0);     //Vertices per Side
+	std::vector<Vertex>   vertices;     //Row Major
+	std::vector<GLuint>   indices;      //Triangle Strip
+
+	GLuint vbo, vao, ibo;
+
+	glm::mat4 model = glm::mat4(1.0f);  //Model Matrix
+
+	void setup();
+	void update();
+	void update(size_t first, size_t count);   //Rewrite a Vertex Range in place
+	void construct(std::function<void(Grid* g)> constructor) {
+		(constructor)(this);  //Keeps the Containers, Sizes rarely change
+		update();
+	};
+
+	void render();
+};
+
+void Grid::setup() {
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ibo);
+}
+
+void Grid::update() {
+	glBindVertexArray(vao);
+
+	//Without Vertices (Displaced from Textures) only the Indices are set
+	if (!vertices.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);               //Height
+		glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, height));
+		glEnableVertexAttribArray(1);               //Normal
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(2);               //Color
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo); //Indices
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+}
+
+void Grid::update(size_t first, size_t count) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), &vertices[first]);
+}
+
+void Grid::render() {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glDrawElements(GL_TRIANGLE_STRIP, indices.size(), GL_UNSIGNED_INT, 0);
+}
 class Particle {
 public:
 	Particle() {       //Construct from an SDL Surface
@@ -360,6 +451,92 @@ void Particle::render() {
 	glBindVertexArray(vao);
 	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, models.size());
 }
+
+/*
+	Instanced Quads with one vec4 per Instance (in_Instance), in a persistent
+	Buffer: slots are replaced in place, and the buffer only grows.
+*/
+
+class Sprites {
+public:
+	Sprites() {
+		setup();
+	};
+
+	~Sprites() {
+		cleanup();
+	}
+
+	//Rendering Data
+	GLuint vao, vbo[2], instance;
+	size_t capacity = 0;          //Slots in the Buffer
+	size_t count = 0;             //Slots drawn
+
+	void setup();
+	void cleanup();
+	void reserve(size_t n, size_t used, const glm::vec4* data);     //New Buffer of n Slots, the first used from data
+	void update(size_t first, size_t n, const glm::vec4* data);     //Replace n Slots
+
+	//Vertex and Texture Positions (as Particle)
+	const GLfloat vert[12] = { -1.0, -1.0,  0.0,
+							 -1.0,  1.0,  0.0,
+							  1.0, -1.0,  0.0,
+							  1.0,  1.0,  0.0 };
+
+	const GLfloat tex[8] = { 0.0,  1.0,
+							  0.0,  0.0,
+							  1.0,  1.0,
+							  1.0,  0.0 };
+
+	void render();
+};
+
+void Sprites::setup() {
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(2, &vbo[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(GLfloat), &vert[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
+	glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), &tex[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+	//Instance Attribute, set up once
+	glGenBuffers(1, &instance);
+	glBindBuffer(GL_ARRAY_BUFFER, instance);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+	glVertexAttribDivisor(2, 1);
+}
+
+void Sprites::cleanup() {
+	glDeleteBuffers(2, vbo);
+	glDeleteBuffers(1, &instance);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void Sprites::reserve(size_t n, size_t used, const glm::vec4* data) {
+	capacity = n;
+	glBindBuffer(GL_ARRAY_BUFFER, instance);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+	if (used > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, used * sizeof(glm::vec4), data);
+}
+
+void Sprites::update(size_t first, size_t n, const glm::vec4* data) {
+	glBindBuffer(GL_ARRAY_BUFFER, instance);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), n * sizeof(glm::vec4), data);
+}
+
+void Sprites::render() {
+	if (count == 0) return;
+	glBindVertexArray(vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
 class Shader {
 public:
 	Shader(std::string vs, std::string fs, slist _list) {
@@ -598,6 +775,14 @@ public:
 	void setup();
 	void cleanup();
 	void raw(SDL_Surface* TextureImage);
+	void floats(int width, int height);                             //Empty Single Channel Float Texture
+	void rows(int first, int count, int width, const GLfloat* data); //Replace Rows of a Float Texture
+
+	//RGBA Rows through a Pixel Unpack Buffer: each Row has its own Place in
+	//the Buffer, so Uploads of one Frame never wait on each other
+	GLuint pbo = 0;
+	void rgba(int width, int height);                               //Empty RGBA Texture and its Buffer
+	void pixels(int first, int count, int width, const GLubyte* data); //Replace Rows, data is Row first
 };
 
 void Texture::setup() {
@@ -606,6 +791,7 @@ void Texture::setup() {
 
 void Texture::cleanup() {
 	glDeleteTextures(1, &texture);
+	if (pbo != 0) glDeleteBuffers(1, &pbo);
 }
 
 void Texture::raw(SDL_Surface* s) {
@@ -616,6 +802,42 @@ void Texture::raw(SDL_Surface* s) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
+void Texture::floats(int width, int height) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Texture::rows(int first, int count, int width, const GLfloat* data) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, width, count, GL_RED, GL_FLOAT, data);
+}
+
+void Texture::rgba(int width, int height) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	if (pbo == 0) glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void Texture::pixels(int first, int count, int width, const GLubyte* data) {
+	const size_t offset = (size_t)first * width * 4;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, (size_t)count * width * 4, data);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, width, count, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
 class View {
 public:
 	bool init(std::string windowName, int width, int height);
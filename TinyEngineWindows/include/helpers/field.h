@@ -0,0 +1,177 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/*
+  Runtime-sized 2D field on the heap. Cell (x, y) lives at x*stride+y.
+
+  Rows are padded to a multiple of 16 cells (at least one spare cell), so the
+  stride is the same for every element type and one index addresses all fields
+  of a map. Rows of float or double start on a cache line, and there is one
+  zeroed halo row before and after the map. Stencils that step one cell off
+  the edge read zeros instead of running off the allocation or wrapping into
+  the next row.
+
+  A field can also view memory it does not own, e.g. a block of a mapped
+  snapshot file (see archive.h). Resizing it allocates its own memory again.
+*/
+
+template<typename T>
+class Field{
+public:
+  Field(){}
+  Field(glm::ivec2 size){ resize(size); }
+  Field(const Field& o){ *this = o; }
+
+  ~Field(){
+    delete[] raw;
+  }
+
+  Field& operator=(const Field& o){
+    if(this == &o) return *this;
+    if(o.base == NULL){ release(); return *this; }
+    if(dim != o.dim) resize(o.dim);
+    if(base != NULL) memcpy(base, o.base, bytes());
+    return *this;
+  }
+
+  glm::ivec2 dim = glm::ivec2(0);
+  int stride = 0;           //Padded Row Length
+  T* data = NULL;           //First Map Row (Past the Halo)
+
+  void resize(glm::ivec2 size);
+  void release();                       //Back to an empty Field, without Memory
+  void clear(){ if(base != NULL) memset((void*)base, 0, bytes()); }
+
+  //Whole Block with Padding and Halo Rows, as written to a Snapshot
+  const char* block() const { return (const char*)base; }
+  char* block(){ return (char*)base; }
+  size_t bytes() const { return (base != NULL)?footprint(dim):0; }  //0 without Memory
+  void view(char* block, glm::ivec2 size);  //Use external Memory in this Layout, not freed
+
+  //Layout of a Size, before any Memory is there
+  static int padded(int height){ return ((height+1+15)/16)*16; }
+  static size_t footprint(glm::ivec2 size){ return (size_t)(size.x+2)*padded(size.y)*sizeof(T); }
+
+  T& operator[](int i){ return data[i]; }
+  const T& operator[](int i) const { return data[i]; }
+
+  int index(glm::ivec2 p) const { return p.x*stride+p.y; }
+  glm::ivec2 pos(int i) const { return glm::ivec2(i/stride, i%stride); }
+  int size() const { return dim.x*stride; }   //Rows incl. Padding, no Halo
+
+  //Index addresses a Map Cell (not Padding or Halo)
+  bool contains(int i) const {
+    return i >= 0 && i < size() && i%stride < dim.y;
+  }
+
+private:
+  static const int ALIGN = 64;
+  char* raw = NULL;
+  T* base = NULL;
+};
+
+template<typename T>
+void Field<T>::resize(glm::ivec2 size){
+  delete[] raw;
+  dim = size;
+  stride = padded(dim.y);
+
+  raw = new char[footprint(dim)+ALIGN];
+  base = (T*)(((uintptr_t)raw + ALIGN-1) & ~(uintptr_t)(ALIGN-1));
+  data = base + stride;
+  clear();
+}
+
+template<typename T>
+void Field<T>::release(){
+  delete[] raw;
+  raw = NULL;
+  base = data = NULL;
+  dim = glm::ivec2(0);
+  stride = 0;
+}
+
+template<typename T>
+void Field<T>::view(char* block, glm::ivec2 size){
+  delete[] raw;
+  raw = NULL;
+  dim = size;
+  stride = padded(dim.y);
+  base = (T*)block;
+  data = base + stride;
+}
+
+/*
+  Changed Cells of a Map: the first and last changed cell of every SEGMENT
+  cells of a row (x > y: none). A write widens the span of its segment, so
+  a reader only revisits the spans and clears them once it is up to date.
+  Drops cross most rows of a map in a call, where one span per row would
+  cover most of the map. Spans can cover a band of rows [first, first+count)
+  of the map, e.g. the region of a tile.
+*/
+
+struct Spans{
+  int first = 0;                        //Map Row of the first Row
+  int count = 0;                        //Rows
+  int height = 0;                       //Cells per Row
+  int stride = 0;                       //Row Length of the Fields (see Field::padded)
+  int segments = 0;                     //Spans per Row
+  std::vector<glm::ivec2> spans;        //Row after Row
+
+  static const int SEGMENT = 64;
+
+  //Rows of a Map of Size dim (n < 0: to the last), all changed
+  void resize(glm::ivec2 dim, int lower = 0, int n = -1){
+    first = lower;
+    count = (n < 0)?(dim.x - lower):n;
+    height = dim.y;
+    stride = Field<char>::padded(dim.y);
+    segments = (dim.y + SEGMENT-1)/SEGMENT;
+    spans.resize((size_t)count*segments);
+    all();
+  }
+
+  void mark(int index){ mark(glm::ivec2(index/stride, index%stride)); }
+  void mark(glm::ivec2 p){
+    glm::ivec2& span = spans[(size_t)(p.x - first)*segments + p.y/SEGMENT];
+    if(p.y < span.x) span.x = p.y;
+    if(p.y > span.y) span.y = p.y;
+  }
+  void mark(int x, glm::ivec2 span){    //All Cells of a Row between
+    if(span.x > span.y) return;
+    for(int s = span.x/SEGMENT; s <= span.y/SEGMENT; s++){
+      mark(glm::ivec2(x, std::max(span.x, s*SEGMENT)));
+      mark(glm::ivec2(x, std::min(span.y, s*SEGMENT+SEGMENT-1)));
+    }
+  }
+  void merge(const Spans& o){
+    for(size_t k = 0; k < o.spans.size(); k++){
+      const glm::ivec2 span = o.spans[k];
+      if(span.x > span.y) continue;
+      const int x = o.first + (int)(k/o.segments);
+      mark(glm::ivec2(x, span.x));
+      mark(glm::ivec2(x, span.y));
+    }
+  }
+
+  void all(){
+    for(size_t k = 0; k < spans.size(); k++){
+      const int s = (int)(k%segments)*SEGMENT;
+      spans[k] = glm::ivec2(s, std::min(s+SEGMENT, height)-1);
+    }
+  }
+  void clear(){ std::fill(spans.begin(), spans.end(), glm::ivec2(height, -1)); }
+
+  //Segments of a Row, or all changed Cells of a Row in one Span
+  const glm::ivec2* row(int x) const { return &spans[(size_t)(x - first)*segments]; }
+  glm::ivec2 operator[](int x) const {
+    glm::ivec2 span = glm::ivec2(height, -1);
+    const glm::ivec2* r = row(x);
+    for(int s = 0; s < segments; s++)
+      span = glm::ivec2(std::min(span.x, r[s].x), std::max(span.y, r[s].y));
+    return span;
+  }
+  glm::ivec2 full() const { return glm::ivec2(0, height-1); }
+};
@@ -50,4 +50,28 @@ namespace image {
     SDL_UnlockSurface(s);
     return s;
   }
+
+  //Padded Fields: One Pixel Row per Field Row
+  template<typename T>
+  SDL_Surface* make(Field<T>& data1, Field<T>& data2, std::function<glm::vec4(T, T)> handle){
+    glm::ivec2 size = data1.dim;
+    SDL_Surface *s = SDL_CreateRGBSurface(0, size.y, size.x, 32, 0, 0, 0, 0);
+    SDL_LockSurface(s);
+
+    for(int x = 0; x < size.x; x++){
+      unsigned char* img_raw = (unsigned char*)s->pixels + x*s->pitch; //Raw Row
+
+      for(int y = 0; y < size.y; y++){
+        int i = data1.index(glm::ivec2(x, y));
+        glm::vec4 color = handle(data1[i], data2[i]);  //Construct from Algorithm
+        *(img_raw+4*y)    = (unsigned char)(255*color.x);
+        *(img_raw+4*y+1)  = (unsigned char)(255*color.y);
+        *(img_raw+4*y+2)  = (unsigned char)(255*color.z);
+        *(img_raw+4*y+3)  = (unsigned char)(255*color.w);
+      }
+    }
+
+    SDL_UnlockSurface(s);
+    return s;
+  }
 };
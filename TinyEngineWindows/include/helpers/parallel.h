@@ -0,0 +1,94 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+namespace parallel{
+
+  //Persistent Worker Pool: Runs an Index Range across all Threads and Blocks
+  class Pool{
+  public:
+    Pool(int n){
+      for(int i = 1; i < n; i++)  //Calling Thread does Work too
+        workers.emplace_back([this](){ serve(); });
+    }
+
+    ~Pool(){
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      wake.notify_all();
+      for(auto& w: workers)
+        w.join();
+    }
+
+    int size(){
+      return workers.size()+1;
+    }
+
+    //Call function(i) for all i in [0, n)
+    template<typename F>
+    void run(int n, F function){
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = function;
+        count = n;
+        next = 0;
+        pending = workers.size();
+        generation++;
+      }
+      wake.notify_all();
+      work();
+
+      //Every Worker has to check in, so no one carries over to the next run
+      std::unique_lock<std::mutex> lock(mutex);
+      finished.wait(lock, [&](){ return pending == 0; });
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+
+    std::function<void(int)> task;
+    std::atomic<int> next{0};
+    int count = 0;
+    int pending = 0;
+    unsigned int generation = 0;
+    bool quit = false;
+
+    void work(){
+      for(int i = next++; i < count; i = next++)
+        task(i);
+    }
+
+    void serve(){
+      unsigned int seen = 0;
+      while(true){
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&](){ return quit || generation != seen; });
+        if(quit) return;
+        seen = generation;
+        lock.unlock();
+
+        work();
+
+        lock.lock();
+        if(--pending == 0)
+          finished.notify_one();
+      }
+    }
+  };
+
+  //Shared Pool, rebuilt when the Thread Count changes (0: Hardware Concurrency)
+  Pool& pool(int n = 0){
+    static std::unique_ptr<Pool> shared;
+    if(n <= 0) n = max(1, (int)std::thread::hardware_concurrency());
+    if(!shared || shared->size() != n)
+      shared.reset(new Pool(n));
+    return *shared;
+  }
+};
@@ -26,6 +26,7 @@ public:
 
   void setup();
   void update();
+  void update(size_t first, size_t count);   //Rewrite a Vertex Range in place
   void construct(std::function<void(Model* m)> constructor){
     positions.clear();  //Clear all Data
     normals.clear();
@@ -71,6 +72,17 @@ void Model::update(){
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
 }
 
+void Model::update(size_t first, size_t count){
+  glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);      //Positions
+  glBufferSubData(GL_ARRAY_BUFFER, 3*first*sizeof(GLfloat), 3*count*sizeof(GLfloat), &positions[3*first]);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);      //Normals
+  glBufferSubData(GL_ARRAY_BUFFER, 3*first*sizeof(GLfloat), 3*count*sizeof(GLfloat), &normals[3*first]);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo[2]);      //Colors
+  glBufferSubData(GL_ARRAY_BUFFER, 4*first*sizeof(GLfloat), 4*count*sizeof(GLfloat), &colors[4*first]);
+}
+
 void Model::translate(const glm::vec3 &axis){
   model = glm::translate(model, axis);
   pos += axis;
@@ -0,0 +1,354 @@
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <vector>
+#include <atomic>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+  World Snapshot File (World::save / World::load), version 2:
+
+    Header          magic, version, scalar size, map size, seed, counters
+    Field Blocks    height, pool, path (baked), plant density; each block is
+                    the whole field allocation (halo rows and padded rows,
+                    see field.h) and starts on a PAGE boundary
+    Tree List       position, index and size per tree
+    Generator       state of the world's std::mt19937 in its text form,
+                    right after the tree list
+
+  Values are in the byte order of the writer, and a file only loads into a
+  world of the same scalar type. The writer makes one streaming pass. The
+  loader maps the file copy-on-write and the fields view their blocks in
+  place, so loading copies nothing, and a page is only copied once the
+  world writes to it. A world with scratch files copies the blocks there
+  (see World::load).
+*/
+
+struct Archive{
+
+  static constexpr const char* MAGIC = "HYDROSNP";
+  static const uint32_t VERSION = 2;
+  static const uint64_t PAGE = 4096;   //Block Alignment
+
+  struct Header{
+    char magic[8];              //MAGIC, not terminated
+    uint32_t version;
+    uint32_t scalar;            //Bytes per Field Value (4 or 8)
+    int32_t dim[2];
+    int32_t stride;
+    int32_t seed;
+    uint32_t epoch;             //Tiled Erosion Calls
+    uint32_t calls;             //erode Calls (Water Path Epoch)
+    double scale;
+    uint64_t blocks[4];         //Offsets of Height, Pool, Path, Plant Density
+    uint64_t trees;             //Offset of the Tree List
+    uint64_t ntrees;
+    uint64_t random;            //Offset of the Generator State
+    uint64_t nrandom;           //Bytes of the Generator State
+  };
+
+  struct Tree{
+    float x, y;
+    int32_t index;
+    float size;
+  };
+
+  static uint64_t align(uint64_t offset){
+    return (offset + PAGE-1)/PAGE*PAGE;
+  }
+
+  //File starts with the Magic
+  static bool probe(std::string file){
+    char magic[8] = {0};
+    std::ifstream in(file, std::ios::binary);
+    in.read(magic, 8);
+    return in && memcmp(magic, MAGIC, 8) == 0;
+  }
+};
+
+/*
+  Mapping of a whole File, unmapped on Destruction. data is NULL if the file
+  could not be mapped. An existing file is mapped privately (copy-on-write);
+  a scratch file is created zeroed at the given size, mapped shared, and
+  removed once it is unmapped.
+
+  A mapped file can not be truncated or replaced while it is in use (see
+  World::save): same() tells whether two names are one file, and replace()
+  renames a finished file over another one.
+*/
+
+class Mapping{
+public:
+  Mapping(std::string file);
+  Mapping(std::string file, uint64_t size);                 //New Scratch File
+  ~Mapping();
+
+  static void advise(const char* p, uint64_t bytes);        //Read Pages in, without waiting
+  static bool same(std::string a, std::string b);           //Both Names are one existing File
+  static bool replace(std::string from, std::string to);    //Rename, over an existing File
+
+  std::string file;
+  char* data = NULL;
+  uint64_t size = 0;
+
+private:
+#ifdef _WIN32
+  HANDLE handle = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#endif
+};
+
+#ifdef _WIN32
+
+Mapping::Mapping(std::string _file):file(_file){
+  handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(handle == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER length;
+  if(!GetFileSizeEx(handle, &length) || length.QuadPart == 0) return;
+  mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if(mapping == NULL) return;
+  data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if(data != NULL) size = length.QuadPart;
+}
+
+Mapping::Mapping(std::string _file, uint64_t length):file(_file){
+  handle = CreateFileA(file.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_DELETE_ON_CLOSE, NULL);
+  if(handle == INVALID_HANDLE_VALUE) return;
+  mapping = CreateFileMappingA(handle, NULL, PAGE_READWRITE, (DWORD)(length>>32), (DWORD)length, NULL);
+  if(mapping == NULL) return;
+  data = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if(data != NULL) size = length;
+}
+
+Mapping::~Mapping(){
+  if(data != NULL) UnmapViewOfFile(data);
+  if(mapping != NULL) CloseHandle(mapping);
+  if(handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+}
+
+void Mapping::advise(const char* p, uint64_t bytes){
+#if _WIN32_WINNT >= 0x0602
+  WIN32_MEMORY_RANGE_ENTRY range = {(PVOID)p, (SIZE_T)bytes};
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+bool Mapping::same(std::string a, std::string b){
+  BY_HANDLE_FILE_INFORMATION info[2];
+  std::string names[2] = {a, b};
+  for(int k = 0; k < 2; k++){
+    HANDLE h = CreateFileA(names[k].c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(h == INVALID_HANDLE_VALUE) return false;
+    BOOL ok = GetFileInformationByHandle(h, &info[k]);
+    CloseHandle(h);
+    if(!ok) return false;
+  }
+  return info[0].dwVolumeSerialNumber == info[1].dwVolumeSerialNumber &&
+         info[0].nFileIndexHigh == info[1].nFileIndexHigh &&
+         info[0].nFileIndexLow == info[1].nFileIndexLow;
+}
+
+bool Mapping::replace(std::string from, std::string to){
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+
+Mapping::Mapping(std::string _file):file(_file){
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd < 0) return;
+  struct stat info;
+  if(fstat(fd, &info) == 0 && info.st_size > 0){
+    void* p = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(p != MAP_FAILED){
+      data = (char*)p;
+      size = info.st_size;
+    }
+  }
+  close(fd);                    //The Mapping keeps the File
+}
+
+Mapping::Mapping(std::string _file, uint64_t length):file(_file){
+  int fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if(fd < 0) return;
+  if(ftruncate(fd, length) == 0){
+    void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p != MAP_FAILED){
+      data = (char*)p;
+      size = length;
+      madvise(p, length, MADV_RANDOM);  //No Readahead, see Scratch
+    }
+  }
+  close(fd);
+  unlink(file.c_str());         //Gone with the Mapping
+}
+
+Mapping::~Mapping(){
+  if(data != NULL) munmap(data, size);
+}
+
+void Mapping::advise(const char* p, uint64_t bytes){
+  const uintptr_t start = (uintptr_t)p & ~(uintptr_t)(sysconf(_SC_PAGESIZE)-1);
+  madvise((void*)start, (uintptr_t)p + bytes - start, MADV_WILLNEED);
+}
+
+bool Mapping::same(std::string a, std::string b){
+  struct stat x, y;
+  if(stat(a.c_str(), &x) != 0 || stat(b.c_str(), &y) != 0) return false;
+  return x.st_dev == y.st_dev && x.st_ino == y.st_ino;
+}
+
+bool Mapping::replace(std::string from, std::string to){
+  return rename(from.c_str(), to.c_str()) == 0;
+}
+
+#endif
+
+/*
+  Out-of-Core Fields: with a scratch prefix, the map-sized fields of a world
+  live in scratch files, one per field, instead of on the heap. The page
+  cache is the working set: a page is read on first touch, and the least
+  recently used pages are written back when memory runs out, so a map may
+  be larger than memory. Fields keep their row-major layout, and all code
+  reads them as before: every kernel steps to its neighbors by 1 and by the
+  stride, which a tiled layout would break on every tile edge.
+
+  So a page holds a piece of one row, and the unit of prefetching is shaped
+  like pages instead: a block is ROWS rows by the COLUMNS cells of a page of
+  4-byte values. A page read for a block then lies in that block, and no
+  other block asks for it again, where a square block would read a whole
+  page per row for a few cells of it.
+
+  Readahead is off, since drops touch cells at random. Instead, ahead() asks
+  for the pages of the blocks of a region of every field, without waiting:
+  the tiled erosion asks for the tiles of the next color, and drops, also
+  in tiles, for the block they are heading into.
+
+  Asking costs a system call, so every block is asked for at most once per
+  erode call (a stamp per block, renewed by renew()), and a block is one
+  call per field: one range over its rows, unless the rows are so far apart
+  that the range would be more than twice the pages of the block, as on
+  wide maps; then one call per row.
+*/
+
+class Scratch{
+public:
+  Scratch(std::string _prefix):prefix(_prefix){}
+
+  //Prefetch Block: ROWS Rows of COLUMNS Cells
+  static const int ROWS = 32;
+  static const int COLUMNS = (int)(Archive::PAGE/4);
+  static glm::ivec2 block(){ return glm::ivec2(ROWS, COLUMNS); }
+
+  //Resize into a new Scratch File, or on the Heap without Scratch
+  template<typename T>
+  static void resize(Field<T>& field, glm::ivec2 dim, Scratch* scratch);
+
+  //Empty the Field, and close its Scratch File if it has one
+  template<typename T>
+  static void release(Field<T>& field, Scratch* scratch);
+
+  void ahead(glm::ivec2 lower, glm::ivec2 upper);   //Blocks of the Region [lower, upper) of every Field
+  void renew(){ generation++; }                     //Blocks may be asked for again
+
+private:
+  struct Layout{
+    const char* base;           //Halo Row
+    int stride;
+    int size;                   //Bytes per Value
+    glm::ivec2 dim;
+  };
+
+  std::string prefix;
+  std::vector<std::unique_ptr<Mapping>> files;
+  std::vector<Layout> layouts;
+
+  glm::ivec2 blocks = glm::ivec2(0);                  //Block Grid of the Map
+  std::unique_ptr<std::atomic<unsigned int>[]> asked; //Generation a Block was asked for in
+  unsigned int generation = 1;
+
+  void fetch(glm::ivec2 lower);                       //Block at lower of every Field
+};
+
+template<typename T>
+void Scratch::resize(Field<T>& field, glm::ivec2 dim, Scratch* scratch){
+  if(scratch == NULL){
+    field.resize(dim);
+    return;
+  }
+
+  static unsigned int serial = 0;  //Files of a replaced Scratch may still be open
+  std::string file = scratch->prefix + "." + std::to_string(serial++);
+  std::unique_ptr<Mapping> map(new Mapping(file, Field<T>::footprint(dim)));
+  if(map->data == NULL){
+    std::cout<<"Could not map "<<file<<", the Field stays in Memory"<<std::endl;
+    field.resize(dim);
+    return;
+  }
+
+  field.view(map->data, dim);  //Zeroed like a resize
+  scratch->layouts.push_back({map->data, field.stride, (int)sizeof(T), dim});
+  scratch->files.push_back(std::move(map));
+
+  const glm::ivec2 grid = (dim + block() - 1)/block();
+  if(grid != scratch->blocks){
+    scratch->blocks = grid;
+    scratch->asked.reset(new std::atomic<unsigned int>[(size_t)grid.x*grid.y]());
+  }
+}
+
+template<typename T>
+void Scratch::release(Field<T>& field, Scratch* scratch){
+  const char* block = field.block();
+  field.release();
+  if(scratch == NULL || block == NULL) return;
+  for(size_t k = 0; k < scratch->files.size(); k++)
+    if(scratch->files[k]->data == block){
+      scratch->files.erase(scratch->files.begin()+k);
+      scratch->layouts.erase(scratch->layouts.begin()+k);
+      return;
+    }
+}
+
+void Scratch::ahead(glm::ivec2 lower, glm::ivec2 upper){
+
+  //Blocks of the Region not asked for in this Call
+  const glm::ivec2 first = glm::max(lower, glm::ivec2(0))/block();
+  const glm::ivec2 last = (glm::min(upper, blocks*block()) - 1)/block();
+  for(int x = first.x; x <= last.x; x++)
+    for(int y = first.y; y <= last.y; y++)
+      if(asked[(size_t)x*blocks.y+y].exchange(generation, std::memory_order_relaxed) != generation)
+        fetch(glm::ivec2(x, y)*block());
+}
+
+void Scratch::fetch(glm::ivec2 lower){
+  for(auto& l: layouts){
+    glm::ivec2 a = lower;
+    glm::ivec2 b = glm::min(lower + block(), l.dim);
+    if(b.x <= a.x || b.y <= a.y) continue;
+
+    const size_t row = (size_t)l.stride*l.size;
+    const size_t width = (size_t)(b.y-a.y)*l.size;
+    const size_t range = (size_t)(b.x-a.x-1)*row + width;
+    const size_t pages = (size_t)(b.x-a.x)*(width/Archive::PAGE + 2);
+    const char* start = l.base + ((size_t)(a.x+1)*l.stride + a.y)*l.size;
+    if(range/Archive::PAGE <= 2*pages)
+      Mapping::advise(start, range);
+    else for(int x = a.x; x < b.x; x++)
+      Mapping::advise(start + (x-a.x)*row, width);
+  }
+}
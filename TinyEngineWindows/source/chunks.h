@@ -0,0 +1,169 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/*
+  Chunked Level of Detail (Geomipmapping): the map is cut into square chunks
+  of SIZE cells. At level l a chunk is drawn as a patch with a vertex every
+  2^l cells, so all chunks at a level share one index strip (displace.vs
+  places the vertices). A ring of skirt vertices hangs below the patch edge
+  and covers the cracks against neighbors at other levels.
+
+  Every chunk keeps the range of its water surface and the vertical error of
+  each level against the full grid. The error of level l is the largest gap
+  between a vertex of level l-1 and the surface of level l under it, taken as
+  a running max, so it never shrinks with the level. A projection is
+  orthographic, so an error looks the same size all over the screen: a chunk
+  takes the coarsest level whose error stays below tolerance pixels.
+*/
+
+class Chunks{
+public:
+  struct Patch{
+    glm::ivec2 origin;          //First Cell
+    int level;
+    float skirt;                //Depth below the Edge
+  };
+
+  static const int SIZE = 128;  //Cells per Chunk Side
+  static const int LEVELS = 7;  //Down to a 2x2 Patch
+
+  //Patch Vertices per Side at a Level, with the Skirt Ring
+  static int side(int level){ return SIZE/(1<<level) + 3; }
+
+  void resize(glm::ivec2 dim);
+  template<typename W> void update(W& world, bool full);   //Bounds and Errors of changed Chunks
+  void select(const glm::mat4& mvp, float pixels, std::vector<Patch>& patches);
+
+  float tolerance = 1.0f;       //Screen Error in Pixels
+
+private:
+  glm::ivec2 dim = glm::ivec2(0);
+  glm::ivec2 count = glm::ivec2(0);
+  std::vector<float> low, high; //Surface Range
+  std::vector<float> error;     //Per Chunk and Level
+  std::vector<bool> stale;
+  std::vector<int> level;       //Selected Level
+
+  template<typename W> void measure(W& world, int c);
+};
+
+void Chunks::resize(glm::ivec2 size){
+  dim = size;
+  count = glm::max((dim - 1 + SIZE - 1)/SIZE, glm::ivec2(1));
+  const int n = count.x*count.y;
+  low.assign(n, 0.0f);
+  high.assign(n, 0.0f);
+  error.assign(n*LEVELS, 0.0f);
+  stale.assign(n, true);
+  level.assign(n, 0);
+}
+
+/*
+  A chunk covers its cells up to and including the first cell of the next
+  one, so a changed cell on a chunk border marks both sides.
+*/
+
+template<typename W>
+void Chunks::update(W& world, bool full){
+
+  if(full || world.dim != dim){
+    resize(world.dim);
+    full = true;
+  }
+
+  for(int i = 0; i < dim.x && !full; i++){
+    glm::ivec2 span = world.dirty[i];
+    if(span.x > span.y) continue;
+    for(int a = std::max(i-1, 0)/SIZE; a <= std::min(i/SIZE, count.x-1); a++)
+    for(int b = std::max(span.x-1, 0)/SIZE; b <= std::min(span.y/SIZE, count.y-1); b++)
+      stale[a*count.y+b] = true;
+  }
+
+  for(int c = 0; c < count.x*count.y; c++){
+    if(!stale[c]) continue;
+    measure(world, c);
+    stale[c] = false;
+  }
+}
+
+template<typename W>
+void Chunks::measure(W& world, int c){
+
+  const glm::ivec2 origin = glm::ivec2(c/count.y, c%count.y)*SIZE;
+  auto surface = [&](int x, int y){
+    int k = world.heightmap.index(glm::min(origin + glm::ivec2(x, y), dim - 1));
+    return (float)(world.scale*(world.heightmap[k] + world.waterpool[k]));
+  };
+
+  //Surface Range
+  low[c] = high[c] = surface(0, 0);
+  for(int x = 0; x <= SIZE; x++)
+    for(int y = 0; y <= SIZE; y++){
+      float s = surface(x, y);
+      low[c] = std::min(low[c], s);
+      high[c] = std::max(high[c], s);
+    }
+
+  //Vertices of Level l-1 that Level l drops, against the Triangle under them
+  float* e = &error[c*LEVELS];
+  e[0] = 0.0f;
+  for(int l = 1; l < LEVELS; l++){
+    const int h = 1<<(l-1);
+    e[l] = e[l-1];
+    for(int x = 0; x <= SIZE; x += h)
+      for(int y = 0; y <= SIZE; y += h){
+        bool odd_x = (x/h)%2, odd_y = (y/h)%2;
+        if(!odd_x && !odd_y) continue;
+        float under;
+        if(odd_x && odd_y) under = 0.5f*(surface(x+h, y-h) + surface(x-h, y+h));  //Quad Diagonal
+        else if(odd_x) under = 0.5f*(surface(x-h, y) + surface(x+h, y));
+        else under = 0.5f*(surface(x, y-h) + surface(x, y+h));
+        e[l] = std::max(e[l], std::abs(surface(x, y) - under));
+      }
+  }
+}
+
+/*
+  pixels is the screen size of one world unit. Chunks with all corners of
+  their bounds outside one clip plane are culled. A skirt reaches below the
+  larger error of the chunk and its neighbors, plus a pixel.
+*/
+
+void Chunks::select(const glm::mat4& mvp, float pixels, std::vector<Patch>& patches){
+
+  patches.clear();
+  const int n = count.x*count.y;
+
+  for(int c = 0; c < n; c++){
+    int l = 0;
+    while(l+1 < LEVELS && error[c*LEVELS+l+1]*pixels <= tolerance) l++;
+    level[c] = l;
+  }
+
+  for(int c = 0; c < n; c++){
+
+    const int a = c/count.y, b = c%count.y;
+    float skirt = error[c*LEVELS+level[c]];
+    if(a > 0) skirt = std::max(skirt, error[(c-count.y)*LEVELS+level[c-count.y]]);
+    if(a+1 < count.x) skirt = std::max(skirt, error[(c+count.y)*LEVELS+level[c+count.y]]);
+    if(b > 0) skirt = std::max(skirt, error[(c-1)*LEVELS+level[c-1]]);
+    if(b+1 < count.y) skirt = std::max(skirt, error[(c+1)*LEVELS+level[c+1]]);
+    skirt = 2.0f*skirt + 1.0f/pixels;
+
+    //Bounds in Clip Space
+    const glm::vec3 lower = glm::vec3(a*SIZE, low[c] - skirt, b*SIZE);
+    const glm::vec3 upper = glm::vec3(std::min((a+1)*SIZE, dim.x-1), high[c], std::min((b+1)*SIZE, dim.y-1));
+    int outside[6] = {0};
+    for(int k = 0; k < 8; k++){
+      glm::vec4 p = mvp*glm::vec4((k&1)?upper.x:lower.x, (k&2)?upper.y:lower.y, (k&4)?upper.z:lower.z, 1.0f);
+      outside[0] += (p.x < -p.w); outside[1] += (p.x > p.w);
+      outside[2] += (p.y < -p.w); outside[3] += (p.y > p.w);
+      outside[4] += (p.z < -p.w); outside[5] += (p.z > p.w);
+    }
+    if(std::find(outside, outside+6, 8) != outside+6)
+      continue;
+
+    patches.push_back({glm::ivec2(a, b)*SIZE, level[c], skirt});
+  }
+}
@@ -0,0 +1,192 @@
+#include <limits>
+#include <algorithm>
+
+/*
+  Depression Map: a priority flood (Barnes et al.) over the water surface h+p,
+  seeded at the map edge. For every cell it stores the spill height, i.e. the
+  level its depression fills up to, and the outlet, the cell that water on it
+  leaves to. A cell below its spill height lies in a depression, and its outlet
+  is the first cell past the spill point. Flat water inherits the outlet of the
+  cell it was reached from, so a full lake points past its rim, not across it.
+
+  Writes only mark their block dirty. A lookup first calls refresh(), which
+  floods a dirty block again, seeded with the stored values around it, so only
+  the blocks floods read are redone, when they read them. Blocks are small,
+  since drops write along every stream and nearly every lookup lands in a
+  dirty block: an 8x8 block refreshes in about 20us, a 32x32 one in 200us.
+  The values around a block can still lag behind the terrain, so callers check
+  an outlet against the current surface before they use it.
+*/
+
+template<typename T>
+class Depressions{
+public:
+  void resize(glm::ivec2 dim, Scratch* scratch = NULL);
+  void release(Scratch* scratch = NULL);              //Free the Map
+  void compute(Field<T>& h, Field<T>& p);             //Full Pass, O(n log n)
+  void update(Field<T>& h, Field<T>& p);              //Full Pass if not valid
+  void refresh(int index, Field<T>& h, Field<T>& p);  //Redo the Block of a Cell if dirty
+  void reset(){ valid = false; }                      //Redo all on next Update
+  size_t bytes() const { return spill.bytes() + outlet.bytes() + stamp.bytes(); }
+
+  //Mark the Block of a written Cell
+  void touch(int index){
+    dirty[block(index)] = true;
+  }
+
+  Field<T> spill;               //Fill Level of the Depression of a Cell
+  Field<int> outlet;            //Cell the Water leaves to (-1: off the Map)
+
+  static const int BLOCK = 8;   //Edge Length of a Dirty Block (one Refresh)
+  static constexpr T tolerance = T(1E-6);  //Surfaces this close count as flat
+
+private:
+  struct Entry{
+    T level;
+    int cell;
+    bool seed;                  //Neighbors may lie off the Map or the Region
+    bool operator>(const Entry& o) const {
+      return (level > o.level) || (level == o.level && cell > o.cell);
+    }
+  };
+
+  glm::ivec2 blocks;
+  std::vector<bool> dirty;
+  bool valid = false;
+
+  Field<unsigned int> stamp;    //Visited in the current Pass
+  unsigned int generation = 0;
+  std::vector<Entry> queue;
+
+  int block(int index){
+    glm::ivec2 p = spill.pos(index)/BLOCK;
+    return p.x*blocks.y + p.y;
+  }
+  void flood(glm::ivec2 lower, glm::ivec2 upper, Field<T>& h, Field<T>& p);
+};
+
+template<typename T>
+void Depressions<T>::resize(glm::ivec2 dim, Scratch* scratch){
+  Scratch::resize(spill, dim, scratch);
+  Scratch::resize(outlet, dim, scratch);
+  Scratch::resize(stamp, dim, scratch);
+  generation = 0;
+  blocks = (dim + BLOCK - 1)/BLOCK;
+  dirty.assign(blocks.x*blocks.y, false);
+  valid = false;
+}
+
+template<typename T>
+void Depressions<T>::release(Scratch* scratch){
+  Scratch::release(spill, scratch);
+  Scratch::release(outlet, scratch);
+  Scratch::release(stamp, scratch);
+  dirty.clear();
+  valid = false;
+}
+
+template<typename T>
+void Depressions<T>::compute(Field<T>& h, Field<T>& p){
+  flood(glm::ivec2(0), spill.dim, h, p);
+  std::fill(dirty.begin(), dirty.end(), false);
+  valid = true;
+}
+
+template<typename T>
+void Depressions<T>::update(Field<T>& h, Field<T>& p){
+  if(!valid) compute(h, p);
+}
+
+template<typename T>
+void Depressions<T>::refresh(int index, Field<T>& h, Field<T>& p){
+
+  if(!valid){
+    compute(h, p);
+    return;
+  }
+
+  int b = block(index);
+  if(!dirty[b]) return;
+  glm::ivec2 origin = glm::ivec2(b/blocks.y, b%blocks.y)*BLOCK;
+  flood(origin, glm::min(origin + BLOCK, spill.dim), h, p);
+  dirty[b] = false;
+}
+
+/*
+  Floods the cells in [lower, upper). Map edge cells in the region drain off
+  the map. The ring just outside the region keeps its stored values and seeds
+  the queue, so the pass joins the rest of the map.
+*/
+
+template<typename T>
+void Depressions<T>::flood(glm::ivec2 lower, glm::ivec2 upper, Field<T>& h, Field<T>& p){
+
+  if(++generation == 0){        //Wrapped: Reset all Stamps
+    stamp.clear();
+    generation = 1;
+  }
+
+  const glm::ivec2 dim = spill.dim;
+  auto inside = [&](int x, int y){
+    return x >= lower.x && x < upper.x && y >= lower.y && y < upper.y;
+  };
+
+  //Seeds: Map Edge in the Region, Ring around the Region
+  queue.clear();
+  for(int x = lower.x-1; x <= upper.x; x++)
+  for(int y = lower.y-1; y <= upper.y; y++){
+    if(x < 0 || y < 0 || x >= dim.x || y >= dim.y) continue;
+
+    int i = spill.index(glm::ivec2(x, y));
+    if(inside(x, y)){
+      if(x > 0 && y > 0 && x < dim.x-1 && y < dim.y-1) continue;
+      spill[i] = h[i] + p[i];
+      outlet[i] = -1;
+    }
+
+    stamp[i] = generation;
+    queue.push_back({spill[i], i, true});
+  }
+  std::make_heap(queue.begin(), queue.end(), std::greater<Entry>());
+
+  const int s = spill.stride;
+  const int n[8] = {s, -s, 1, -1, s+1, -s-1, s-1, -s+1};
+
+  while(!queue.empty()){
+
+    Entry top = queue.front();
+    std::pop_heap(queue.begin(), queue.end(), std::greater<Entry>());
+    queue.pop_back();
+    const int c = top.cell;
+
+    //Other Cells only border the Region and the Seeds
+    for(auto& o: n){
+      int j = c+o;
+      if(top.seed){
+        if(!spill.contains(j)) continue;
+        glm::ivec2 q = spill.pos(j);
+        if(!inside(q.x, q.y)) continue;
+      }
+      if(stamp[j] == generation)
+        continue;
+      stamp[j] = generation;
+
+      T surface = h[j] + p[j];
+
+      //Raised or Flat: Same Outlet as the Cell it was reached from
+      if(surface < spill[c] + tolerance){
+        spill[j] = (surface > spill[c])?surface:spill[c];
+        outlet[j] = (outlet[c] >= 0)?outlet[c]:c;
+      }
+
+      //Uphill: Drains back the Way it was reached
+      else{
+        spill[j] = surface;
+        outlet[j] = c;
+      }
+
+      queue.push_back({spill[j], j, false});
+      std::push_heap(queue.begin(), queue.end(), std::greater<Entry>());
+    }
+  }
+}
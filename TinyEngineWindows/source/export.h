@@ -0,0 +1,587 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+
+/*
+  Field Export for downstream Tools, without SDL: raw float32, 16-bit gray
+  PNG and tiled float OpenEXR. Pixel rows are field rows, so an image is
+  dim.y wide and dim.x high, like image::make.
+
+  Every format is cut into bands of rows. The bands of one round encode on
+  all threads (see parallel.h) and are then written in order, so a file is
+  written in one streaming pass and only one band per thread is in memory.
+  Raw and EXR values are little-endian on any host.
+
+  PNG lines are filtered with the usual heuristic, and each band is deflated
+  on its own (see deflate) into its own IDAT chunk with its own CRC. The
+  Adler-32 sums of the bands are combined for the zlib trailer. The value
+  range of the field goes into a tEXt chunk ("Range"), so the 16-bit values
+  can be scaled back.
+  EXR files are uncompressed and tiled (one level), one FLOAT channel per
+  field, which most image tools and game engines read.
+*/
+
+namespace exporter {
+
+  const int BAND = 64;          //Rows per Band, and the EXR Tile Size
+
+  template<typename T>
+  struct Channel{
+    std::string name;
+    Field<T>* field;
+  };
+
+  //Encode Band b into a Buffer, for all Bands, and write them in Order
+  template<typename F>
+  bool stream(std::ofstream& out, int bands, int threads, F encode){
+    parallel::Pool& pool = parallel::pool(threads);
+    std::vector<std::vector<char>> buffers(pool.size());
+    for(int first = 0; first < bands; first += pool.size()){
+      int n = std::min(pool.size(), bands - first);
+      pool.run(n, [&](int k){
+        buffers[k].clear();
+        encode(first + k, buffers[k]);
+      });
+      for(int k = 0; k < n; k++)
+        out.write(buffers[k].data(), buffers[k].size());
+    }
+    return (bool)out;
+  }
+
+  void put(std::vector<char>& b, const void* data, size_t size){
+    b.insert(b.end(), (const char*)data, (const char*)data + size);
+  }
+
+  void put32(std::vector<char>& b, uint32_t v){       //Big-Endian (PNG)
+    char c[4] = {(char)(v>>24), (char)(v>>16), (char)(v>>8), (char)v};
+    put(b, c, 4);
+  }
+
+  //Host Byte Order
+  bool little(){
+    const uint16_t one = 1;
+    return *(const char*)&one == 1;
+  }
+
+  template<typename V>
+  void putle(std::vector<char>& b, V v){              //Little-Endian (EXR)
+    char c[sizeof(V)];
+    memcpy(c, &v, sizeof(V));
+    if(!little()) std::reverse(c, c + sizeof(V));
+    put(b, c, sizeof(V));
+  }
+
+  //n 4-Byte Values at p to Little-Endian (Nothing on little-endian Hosts)
+  void little32(char* p, size_t n){
+    if(little()) return;
+    for(size_t i = 0; i < n; i++, p += 4){
+      std::swap(p[0], p[3]);
+      std::swap(p[1], p[2]);
+    }
+  }
+
+  //Smallest and largest Value of a Field
+  template<typename T>
+  glm::vec2 range(Field<T>& field, int threads){
+    const int bands = (field.dim.x + BAND - 1)/BAND;
+    std::vector<glm::vec2> r(bands);
+    parallel::pool(threads).run(bands, [&](int b){
+      const T* row = &field[field.index(glm::ivec2(b*BAND, 0))];
+      T lo = row[0], hi = row[0];
+      for(int x = b*BAND; x < std::min((b+1)*BAND, field.dim.x); x++){
+        row = &field[field.index(glm::ivec2(x, 0))];
+        for(int y = 0; y < field.dim.y; y++){
+          lo = (row[y] < lo)?row[y]:lo;
+          hi = (row[y] > hi)?row[y]:hi;
+        }
+      }
+      r[b] = glm::vec2(lo, hi);
+    });
+    glm::vec2 total = r[0];
+    for(auto& v: r)
+      total = glm::vec2(std::min(total.x, v.x), std::max(total.y, v.y));
+    return total;
+  }
+
+  /*
+  ================================================
+                    RAW FLOAT32
+  ================================================
+  */
+
+  template<typename T>
+  bool raw(std::string file, Field<T>& field, int threads = 0){
+    std::ofstream out(file, std::ios::binary);
+    if(!out) return false;
+    const int bands = (field.dim.x + BAND - 1)/BAND;
+    return stream(out, bands, threads, [&](int b, std::vector<char>& buffer){
+      const int first = b*BAND, last = std::min(first + BAND, field.dim.x);
+      buffer.resize((size_t)(last-first)*field.dim.y*sizeof(float));
+      float* values = (float*)buffer.data();
+      for(int x = first; x < last; x++){
+        const T* row = &field[field.index(glm::ivec2(x, 0))];
+        for(int y = 0; y < field.dim.y; y++)
+          *values++ = (float)row[y];
+      }
+      little32(buffer.data(), buffer.size()/4);
+    });
+  }
+
+  /*
+  ================================================
+                 DEFLATE (RFC 1951)
+  ================================================
+  */
+
+  /*
+    A band is one dynamic Huffman block of greedy LZ77 matches, found over
+    hash chains within the band only, and an empty stored block that ends
+    it on a byte boundary. Like zlib with a full flush after every band,
+    bands share no history: they compress on all threads, and their blocks
+    follow each other in one zlib stream.
+  */
+
+  const uint16_t LENGTHS[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  const uint8_t LENGTHBITS[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  const uint16_t DISTANCES[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  const uint8_t DISTANCEBITS[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  //Bits, least significant first
+  struct Bits{
+    std::vector<char>& out;
+    uint64_t bits = 0;
+    int count = 0;
+    Bits(std::vector<char>& _out):out(_out){}
+    void put(uint32_t value, int length){
+      bits |= (uint64_t)value << count;
+      count += length;
+      for(; count >= 8; count -= 8, bits >>= 8)
+        out.push_back((char)bits);
+    }
+    void align(){ if(count > 0) put(0, 8 - count); }
+  };
+
+  //Code Lengths of at most limit Bits: Huffman, with Frequencies halved until it fits
+  std::vector<uint8_t> lengths(std::vector<uint32_t> freq, int limit){
+    const int n = freq.size();
+    std::vector<uint8_t> length(n, 0);
+    while(true){
+      std::vector<std::pair<uint64_t, int>> heap;   //Weight and Node
+      std::vector<int> parent(n, -1);
+      for(int s = 0; s < n; s++)
+        if(freq[s] > 0) heap.push_back({freq[s], s});
+      std::greater<std::pair<uint64_t, int>> order;
+      std::make_heap(heap.begin(), heap.end(), order);
+      while(heap.size() > 1){
+        std::pop_heap(heap.begin(), heap.end(), order);
+        auto a = heap.back(); heap.pop_back();
+        std::pop_heap(heap.begin(), heap.end(), order);
+        auto b = heap.back(); heap.pop_back();
+        parent[a.second] = parent[b.second] = parent.size();
+        heap.push_back({a.first + b.first, (int)parent.size()});
+        parent.push_back(-1);
+        std::push_heap(heap.begin(), heap.end(), order);
+      }
+
+      bool fits = true;
+      for(int s = 0; s < n; s++){
+        if(freq[s] == 0) continue;
+        int depth = 0;
+        for(int p = s; parent[p] >= 0; p = parent[p]) depth++;
+        length[s] = depth;
+        fits = fits && depth <= limit;
+      }
+      if(fits) return length;
+      for(auto& f: freq)
+        f = (f + 1)/2;
+    }
+  }
+
+  //Canonical Codes, bit-reversed for Bits
+  std::vector<uint16_t> codes(const std::vector<uint8_t>& length){
+    int count[16] = {0}, next[16] = {0};
+    for(auto l: length)
+      if(l > 0) count[l]++;
+    for(int bits = 1, code = 0; bits < 16; bits++)
+      next[bits] = code = (code + count[bits-1]) << 1;
+    std::vector<uint16_t> code(length.size(), 0);
+    for(size_t s = 0; s < length.size(); s++){
+      if(length[s] == 0) continue;
+      int c = next[length[s]]++, r = 0;
+      for(int i = 0; i < length[s]; i++, c >>= 1)
+        r = (r << 1) | (c & 1);
+      code[s] = r;
+    }
+    return code;
+  }
+
+  //At least two Codes, so every Tree is complete
+  void two(std::vector<uint32_t>& freq){
+    int used = 0;
+    for(auto f: freq) used += (f > 0);
+    for(size_t s = 0; used < 2 && s < freq.size(); s++)
+      if(freq[s] == 0){
+        freq[s] = 1;
+        used++;
+      }
+  }
+
+  void deflate(const unsigned char* data, size_t size, bool last, std::vector<char>& out){
+
+    //Greedy Matches over Hash Chains of 3 Bytes (distance 0: Literal)
+    const int WINDOW = 32768, CHAIN = 64, HASH = 1 << 15;
+    struct Symbol{ uint16_t length, distance; };
+    std::vector<Symbol> symbols;
+    std::vector<int> head(HASH, -1), prev(size);
+    auto hash = [&](size_t i){ return ((data[i] << 10) ^ (data[i+1] << 5) ^ data[i+2]) & (HASH-1); };
+
+    for(size_t i = 0; i < size;){
+      int best = 0, distance = 0;
+      if(i + 2 < size){
+        const int limit = (int)std::min(size - i, (size_t)258);
+        int c = head[hash(i)];
+        for(int k = 0; k < CHAIN && c >= 0 && (int)i - c <= WINDOW; k++, c = prev[c]){
+          int l = 0;
+          while(l < limit && data[c+l] == data[i+l]) l++;
+          if(l > best){
+            best = l;
+            distance = (int)i - c;
+            if(l == limit) break;
+          }
+        }
+      }
+      if(best < 3) best = 0;
+      symbols.push_back(best?Symbol{(uint16_t)best, (uint16_t)distance}:Symbol{data[i], 0});
+      for(size_t end = i + (best?best:1); i < end; i++)
+        if(i + 2 < size){
+          const int h = hash(i);
+          prev[i] = head[h];
+          head[h] = (int)i;
+        }
+    }
+
+    auto lengthcode = [](int l){ return (int)(std::upper_bound(LENGTHS, LENGTHS + 29, l) - LENGTHS) - 1; };
+    auto distancecode = [](int d){ return (int)(std::upper_bound(DISTANCES, DISTANCES + 30, d) - DISTANCES) - 1; };
+
+    //Huffman Codes of the Band
+    std::vector<uint32_t> lf(286, 0), df(30, 0);
+    for(auto& s: symbols){
+      if(s.distance == 0) lf[s.length]++;
+      else{
+        lf[257 + lengthcode(s.length)]++;
+        df[distancecode(s.distance)]++;
+      }
+    }
+    lf[256] = 1;                                           //End of Block
+    two(lf);
+    two(df);
+    const std::vector<uint8_t> ll = lengths(lf, 15), dl = lengths(df, 15);
+    const std::vector<uint16_t> lc = codes(ll), dc = codes(dl);
+    int hlit = 286, hdist = 30;
+    while(ll[hlit-1] == 0) hlit--;
+    while(dl[hdist-1] == 0) hdist--;
+
+    //Code Lengths, run-length coded (16: Repeat, 17 and 18: Zeros)
+    std::vector<uint8_t> all(ll.begin(), ll.begin() + hlit);
+    all.insert(all.end(), dl.begin(), dl.begin() + hdist);
+    std::vector<glm::ivec2> runs;                          //Code and Extra Bits
+    for(size_t k = 0; k < all.size();){
+      size_t r = 1;
+      while(k + r < all.size() && all[k+r] == all[k]) r++;
+      if(all[k] == 0 && r >= 3){
+        r = std::min(r, (size_t)138);
+        runs.push_back((r >= 11)?glm::ivec2(18, r-11):glm::ivec2(17, r-3));
+      }
+      else if(all[k] != 0 && r >= 4){
+        r = 1 + std::min(r-1, (size_t)6);
+        runs.push_back(glm::ivec2(all[k], 0));
+        runs.push_back(glm::ivec2(16, r-4));
+      }
+      else{
+        r = 1;
+        runs.push_back(glm::ivec2(all[k], 0));
+      }
+      k += r;
+    }
+    std::vector<uint32_t> cf(19, 0);
+    for(auto& r: runs) cf[r.x]++;
+    two(cf);
+    const std::vector<uint8_t> cl = lengths(cf, 7);
+    const std::vector<uint16_t> cc = codes(cl);
+    const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    int hclen = 19;
+    while(cl[order[hclen-1]] == 0) hclen--;
+
+    //Dynamic Block, never the final one
+    Bits bits(out);
+    bits.put(2 << 1, 3);
+    bits.put(hlit - 257, 5);
+    bits.put(hdist - 1, 5);
+    bits.put(hclen - 4, 4);
+    for(int k = 0; k < hclen; k++)
+      bits.put(cl[order[k]], 3);
+    const int extra[3] = {2, 3, 7};
+    for(auto& r: runs){
+      bits.put(cc[r.x], cl[r.x]);
+      if(r.x >= 16) bits.put(r.y, extra[r.x-16]);
+    }
+
+    for(auto& s: symbols){
+      if(s.distance == 0){
+        bits.put(lc[s.length], ll[s.length]);
+        continue;
+      }
+      const int l = lengthcode(s.length), d = distancecode(s.distance);
+      bits.put(lc[257+l], ll[257+l]);
+      bits.put(s.length - LENGTHS[l], LENGTHBITS[l]);
+      bits.put(dc[d], dl[d]);
+      bits.put(s.distance - DISTANCES[d], DISTANCEBITS[d]);
+    }
+    bits.put(lc[256], ll[256]);
+
+    //Empty stored Block to the Byte Boundary, final after the last Band
+    bits.put(last?1:0, 3);
+    bits.align();
+    put(out, "\x00\x00\xff\xff", 4);
+  }
+
+  /*
+  ================================================
+                    16-BIT PNG
+  ================================================
+  */
+
+  uint32_t crc(const char* data, size_t size, uint32_t c = 0){
+    static const std::vector<uint32_t> table = [](){
+      std::vector<uint32_t> t(256);
+      for(uint32_t n = 0; n < 256; n++){
+        uint32_t k = n;
+        for(int i = 0; i < 8; i++)
+          k = (k & 1)?(0xEDB88320u ^ (k >> 1)):(k >> 1);
+        t[n] = k;
+      }
+      return t;
+    }();
+    c = ~c;
+    for(size_t i = 0; i < size; i++)
+      c = table[(c ^ (unsigned char)data[i]) & 0xFF] ^ (c >> 8);
+    return ~c;
+  }
+
+  //Adler-32 as (a, b), and of two Sequences one after the other
+  glm::uvec2 adler(const unsigned char* data, size_t size){
+    uint32_t a = 1, b = 0;
+    while(size > 0){
+      size_t n = std::min(size, (size_t)5552);        //No Overflow before the Modulo
+      size -= n;
+      while(n--){
+        a += *data++;
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    return glm::uvec2(a, b);
+  }
+
+  glm::uvec2 adler(glm::uvec2 first, glm::uvec2 second, size_t size){
+    uint32_t a = (first.x + second.x + 65521 - 1) % 65521;
+    uint32_t b = (uint32_t)((first.y + second.y + (uint64_t)(size % 65521)*(first.x + 65521 - 1)) % 65521);
+    return glm::uvec2(a, b);
+  }
+
+  //Line with the Filter whose Bytes have the smallest Sum as signed Values
+  //(the usual Heuristic), behind its Filter Type; up is the Line above
+  void filter(const unsigned char* line, const unsigned char* up, size_t n, unsigned char* out){
+    std::vector<unsigned char> trial(n);
+    long best = -1;
+    for(int f = 0; f < 5; f++){
+      long sum = 0;
+      for(size_t i = 0; i < n; i++){
+        const int a = (i >= 2)?line[i-2]:0, b = up[i], c = (i >= 2)?up[i-2]:0;
+        int p = 0;
+        if(f == 1) p = a;
+        else if(f == 2) p = b;
+        else if(f == 3) p = (a + b)/2;
+        else if(f == 4){
+          const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2*c);
+          p = (pa <= pb && pa <= pc)?a:(pb <= pc)?b:c;
+        }
+        trial[i] = (unsigned char)(line[i] - p);
+        sum += (trial[i] < 128)?trial[i]:256 - trial[i];
+      }
+      if(best < 0 || sum < best){
+        best = sum;
+        out[0] = f;
+        memcpy(out + 1, trial.data(), n);
+      }
+    }
+  }
+
+  //Chunk with Length and CRC around data
+  void chunk(std::vector<char>& b, const char* type, const char* data, size_t size){
+    put32(b, (uint32_t)size);
+    size_t start = b.size();
+    put(b, type, 4);
+    put(b, data, size);
+    put32(b, crc(b.data() + start, size + 4));
+  }
+
+  template<typename T>
+  bool png(std::string file, Field<T>& field, glm::vec2 limits, int threads = 0){
+    std::ofstream out(file, std::ios::binary);
+    if(!out) return false;
+
+    const int width = field.dim.y, height = field.dim.x;
+    const int bands = (height + BAND - 1)/BAND;
+    const size_t line = 1 + 2*(size_t)width;              //Filter Byte and Samples
+    const float scale = (limits.y > limits.x)?65535.0f/(limits.y - limits.x):0.0f;
+
+    std::vector<char> head;
+    put(head, "\x89PNG\r\n\x1a\n", 8);
+    std::vector<char> ihdr;
+    put32(ihdr, width);
+    put32(ihdr, height);
+    put(ihdr, "\x10\x00\x00\x00\x00", 5);                  //16 Bit Gray, no Interlace
+    chunk(head, "IHDR", ihdr.data(), ihdr.size());
+    char text[64] = "Range";
+    int n = snprintf(text + 6, sizeof(text) - 6, "%.9g %.9g", limits.x, limits.y);
+    chunk(head, "tEXt", text, 6 + n);
+    chunk(head, "IDAT", "\x78\x01", 2);                    //zlib Header
+    out.write(head.data(), head.size());
+
+    std::vector<glm::uvec2> sums(bands);
+    std::vector<size_t> sizes(bands);
+    bool ok = stream(out, bands, threads, [&](int b, std::vector<char>& buffer){
+
+      //Samples of Row x, big-endian (Zeros above the first Row)
+      const int first = b*BAND, last = std::min(first + BAND, height);
+      auto samples = [&](int x, unsigned char* p){
+        if(x < 0){
+          memset(p, 0, line-1);
+          return;
+        }
+        const T* row = &field[field.index(glm::ivec2(x, 0))];
+        for(int y = 0; y < width; y++){
+          float v = std::min(std::max(((float)row[y] - limits.x)*scale, 0.0f), 65535.0f);
+          uint16_t s = (uint16_t)(v + 0.5f);
+          *p++ = (unsigned char)(s >> 8);
+          *p++ = (unsigned char)s;
+        }
+      };
+
+      std::vector<unsigned char> lines((last-first)*line), up(line-1), row(line-1);
+      samples(first-1, up.data());
+      for(int x = first; x < last; x++){
+        samples(x, row.data());
+        filter(row.data(), up.data(), line-1, &lines[(x-first)*line]);
+        std::swap(row, up);
+      }
+      sums[b] = adler(lines.data(), lines.size());
+      sizes[b] = lines.size();
+
+      std::vector<char> data;
+      deflate(lines.data(), lines.size(), b+1 == bands, data);
+      chunk(buffer, "IDAT", data.data(), data.size());
+    });
+
+    glm::uvec2 sum = sums[0];
+    for(int b = 1; b < bands; b++)
+      sum = adler(sum, sums[b], sizes[b]);
+
+    std::vector<char> tail, trailer;
+    put32(trailer, (sum.y << 16) | sum.x);
+    chunk(tail, "IDAT", trailer.data(), 4);
+    chunk(tail, "IEND", NULL, 0);
+    out.write(tail.data(), tail.size());
+    return ok && (bool)out;
+  }
+
+  /*
+  ================================================
+                  TILED FLOAT EXR
+  ================================================
+  */
+
+  void attribute(std::vector<char>& b, std::string name, std::string type, const std::vector<char>& value){
+    put(b, name.c_str(), name.size()+1);
+    put(b, type.c_str(), type.size()+1);
+    putle<int32_t>(b, value.size());
+    put(b, value.data(), value.size());
+  }
+
+  template<typename T>
+  bool exr(std::string file, std::vector<Channel<T>> channels, int threads = 0){
+    std::ofstream out(file, std::ios::binary);
+    if(!out || channels.empty()) return false;
+
+    //Channels are stored by Name
+    std::sort(channels.begin(), channels.end(), [](const Channel<T>& a, const Channel<T>& b){ return a.name < b.name; });
+    const glm::ivec2 dim = channels[0].field->dim;
+    const int width = dim.y, height = dim.x;
+    const glm::ivec2 tiles = (glm::ivec2(width, height) + BAND - 1)/BAND;
+
+    std::vector<char> head, v;
+    putle<uint32_t>(head, 20000630);                      //Magic
+    putle<uint32_t>(head, 2 | 0x200);                     //Version 2, Tiled
+
+    for(auto& c: channels){
+      put(v, c.name.c_str(), c.name.size()+1);
+      putle<int32_t>(v, 2);                               //FLOAT
+      putle<int32_t>(v, 0);                               //pLinear, Reserved
+      putle<int32_t>(v, 1);                               //Sampling
+      putle<int32_t>(v, 1);
+    }
+    v.push_back(0);
+    attribute(head, "channels", "chlist", v);
+    attribute(head, "compression", "compression", {0});
+    v.clear();
+    for(int32_t i: {0, 0, width-1, height-1}) putle<int32_t>(v, i);
+    attribute(head, "dataWindow", "box2i", v);
+    attribute(head, "displayWindow", "box2i", v);
+    attribute(head, "lineOrder", "lineOrder", {0});
+    v.clear(); putle<float>(v, 1.0f);
+    attribute(head, "pixelAspectRatio", "float", v);
+    attribute(head, "screenWindowWidth", "float", v);
+    v.clear(); putle<float>(v, 0.0f); putle<float>(v, 0.0f);
+    attribute(head, "screenWindowCenter", "v2f", v);
+    v.clear(); putle<uint32_t>(v, BAND); putle<uint32_t>(v, BAND); v.push_back(0);
+    attribute(head, "tiles", "tiledesc", v);
+    head.push_back(0);
+
+    //Tile Offsets, known up front without Compression
+    uint64_t offset = head.size() + (uint64_t)tiles.x*tiles.y*8;
+    for(int ty = 0; ty < tiles.y; ty++)
+      for(int tx = 0; tx < tiles.x; tx++){
+        putle<uint64_t>(head, offset);
+        glm::ivec2 size = glm::min(glm::ivec2(width, height) - glm::ivec2(tx, ty)*BAND, glm::ivec2(BAND));
+        offset += 20 + (uint64_t)size.x*size.y*channels.size()*4;
+      }
+    out.write(head.data(), head.size());
+
+    //A Band is a Row of Tiles, Lines of a Tile are Channel after Channel
+    return stream(out, tiles.y, threads, [&](int ty, std::vector<char>& buffer){
+      for(int tx = 0; tx < tiles.x; tx++){
+        glm::ivec2 size = glm::min(glm::ivec2(width, height) - glm::ivec2(tx, ty)*BAND, glm::ivec2(BAND));
+        for(int32_t i: {tx, ty, 0, 0}) putle<int32_t>(buffer, i);
+        putle<int32_t>(buffer, size.x*size.y*channels.size()*4);
+        size_t at = buffer.size();
+        buffer.resize(at + (size_t)size.x*size.y*channels.size()*4);
+        float* values = (float*)(buffer.data() + at);
+        for(int x = ty*BAND; x < ty*BAND + size.y; x++)
+          for(auto& c: channels){
+            const T* row = &(*c.field)[c.field->index(glm::ivec2(x, tx*BAND))];
+            for(int y = 0; y < size.x; y++)
+              *values++ = (float)row[y];
+          }
+        little32(buffer.data() + at, (size_t)size.x*size.y*channels.size());
+      }
+    });
+  }
+
+};
@@ -0,0 +1,364 @@
+#include <limits>
+#include <algorithm>
+
+/*
+  Lake Registry: settled pools with their cells, surface level, stored volume
+  and spill point. A drop that ends in a known lake raises its level in O(1)
+  instead of flooding it again. Volume that reaches the lowest rim cell takes
+  that cell in and keeps rising, so the lake grows like a priority flood. Once
+  a rim cell has a lower neighbor, that neighbor is the drain: the lake
+  overflows there and slowly drains toward it, like the flood does.
+
+  The pool depths of changed lakes are written back in one pass by flush(),
+  which records the cells in written (see Spans in field.h).
+  Eroding the floor of a lake keeps its surface flat, writes on the rim move
+  the spill point. Writing a pool depth in a lake, or raising its floor above
+  the surface, drops it from the registry, and the next flood there registers
+  it again.
+*/
+
+template<typename T>
+struct Rim{
+  T surface;
+  int cell;
+  bool operator>(const Rim& o) const { return surface > o.surface; }
+};
+
+template<typename T>
+struct Lake{
+  std::vector<int> cells;
+  std::vector<Rim<T>> rim;      //Min-Heap of Cells around the Lake
+  T level;                      //Surface Height (h+p) of all Cells
+  T spill;                      //Surface of the Drain
+  int drain;                    //Lower Cell the Lake overflows into (-1: None)
+  T volume;                     //Stored Water (Pool Depth summed over Cells)
+  bool dirty = false;           //Level is ahead of the stored Pool Depths
+
+  bool overflowing(){ return drain >= 0; }
+};
+
+template<typename T>
+class Lakes{
+public:
+  void resize(glm::ivec2 dim, Scratch* scratch = NULL);
+  void release(Scratch* scratch = NULL);  //Forget all Lakes and free the Cells
+  void reset();                 //Forget all Lakes, Pool Depths stay as they are
+
+  bool add(int index, T& volume, T volumeFactor, Field<T>& h, Field<T>& p, int& drain);
+  void capture(int index, Field<T>& h, Field<T>& p);
+  void touch(int index, Field<T>& h, Field<T>& p, bool depth = false);  //After a Write at index
+  void flush(Field<T>& h, Field<T>& p);             //Write pending Levels
+  void clear(Field<T>& h, Field<T>& p){ flush(h, p); reset(); }
+
+  int count(){ return lakes.size() - free.size(); }
+  size_t bytes() const;         //Cell Map and Lake Lists
+
+  Field<int> id;                //Lake of a Cell plus one (0: None)
+  Spans written;                //Cells written back since the Owner took them
+  std::vector<Lake<T>> lakes;
+
+private:
+  std::vector<int> free;        //Unused Slots
+  std::vector<int> dirty;       //Lakes with pending Levels
+  std::vector<int> stack;       //Capture Scratch
+
+  static constexpr T tolerance = T(1E-6);  //Rounding of (level - h) + h
+  static constexpr T drainage = T(0.001);  //Same Rate as the Flood
+
+  void join(int l, int cell, Field<T>& h, Field<T>& p);
+  void push(Lake<T>& lake, T surface, int cell);
+  void write(Lake<T>& lake, Field<T>& h, Field<T>& p);
+  void drop(int l, Field<T>& h, Field<T>& p);
+};
+
+template<typename T>
+void Lakes<T>::resize(glm::ivec2 dim, Scratch* scratch){
+  Scratch::resize(id, dim, scratch);
+  written.resize(dim);
+  written.clear();
+  reset();
+}
+
+template<typename T>
+void Lakes<T>::release(Scratch* scratch){
+  lakes.clear();
+  reset();
+  written = Spans();
+  Scratch::release(id, scratch);
+}
+
+template<typename T>
+void Lakes<T>::reset(){
+  if(!lakes.empty()) id.clear();
+  lakes.clear();
+  free.clear();
+  dirty.clear();
+}
+
+template<typename T>
+size_t Lakes<T>::bytes() const {
+  size_t n = id.bytes() + lakes.size()*sizeof(Lake<T>);
+  for(auto& lake: lakes)
+    n += lake.cells.size()*sizeof(int) + lake.rim.size()*sizeof(Rim<T>);
+  return n;
+}
+
+/*
+  Below the lowest rim cell no cell joins the lake, so the volume spreads
+  evenly over the known cells. An overflowing lake keeps the volume of the
+  drop and hands back its drain.
+*/
+
+template<typename T>
+bool Lakes<T>::add(int index, T& volume, T volumeFactor, Field<T>& h, Field<T>& p, int& drain){
+
+  int l = id[index]-1;
+  if(l < 0) return false;
+
+  Lake<T>& lake = lakes[l];
+  if(h[index] > lake.level)     //Fell dry while draining
+    return false;
+
+  if(!lake.dirty){
+    lake.dirty = true;
+    dirty.push_back(l);
+  }
+
+  while(!lake.overflowing()){
+
+    //Lowest Rim Cell (Re-sorted if it changed since it was pushed)
+    T surface = std::numeric_limits<T>::max();
+    int cell = -1;
+    while(!lake.rim.empty()){
+      Rim<T> top = lake.rim.front();
+      std::pop_heap(lake.rim.begin(), lake.rim.end(), std::greater<Rim<T>>());
+      lake.rim.pop_back();
+      if(id[top.cell] == l+1) continue;
+
+      T current = h[top.cell] + p[top.cell];
+      if(current != top.surface){
+        push(lake, current, top.cell);
+        continue;
+      }
+      surface = top.surface;
+      cell = top.cell;
+      break;
+    }
+
+    //Rim Cell sank below the Surface
+    if(cell >= 0 && surface < lake.level - tolerance){
+      lake.spill = surface;
+      lake.drain = cell;
+      break;
+    }
+
+    //Fits below the Rim
+    T area = (T)lake.cells.size();
+    T room = volumeFactor*(surface - lake.level)*area;
+    if(cell < 0 || volume < room){
+      lake.level += volume/volumeFactor/area;
+      lake.volume += volume/volumeFactor;
+      volume = T(0);
+      drain = -1;
+      return true;
+    }
+
+    //Fill up to the Rim Cell and take it in
+    if(room > T(0)){
+      lake.level = surface;
+      lake.volume += room/volumeFactor;
+      volume -= room;
+    }
+    join(l, cell, h, p);
+  }
+
+  lake.level = (T(1)-drainage)*lake.level + drainage*lake.spill;
+  drain = lake.drain;
+  return true;
+}
+
+/*
+  Collects the cells connected to index at its surface height, in the same
+  8-neighborhood as the flood, and the rim around them. As in the flood, the
+  highest neighbor below the surface is the drain.
+*/
+
+template<typename T>
+void Lakes<T>::capture(int index, Field<T>& h, Field<T>& p){
+
+  if(id[index] != 0 || p[index] <= T(0))
+    return;
+
+  int l;
+  if(free.empty()){
+    l = lakes.size();
+    lakes.emplace_back();
+  }
+  else{
+    l = free.back();
+    free.pop_back();
+  }
+
+  Lake<T>& lake = lakes[l];
+  lake.cells.clear();
+  lake.rim.clear();
+  lake.level = h[index] + p[index];
+  lake.spill = T(0);
+  lake.drain = -1;
+  lake.volume = T(0);
+  lake.dirty = false;
+
+  stack.clear();
+  stack.push_back(index);
+  id[index] = l+1;
+
+  const int s = h.stride;
+  const int n[8] = {s, -s, 1, -1, s+1, -s-1, s-1, -s+1};
+
+  while(!stack.empty()){
+
+    int i = stack.back();
+    stack.pop_back();
+    lake.cells.push_back(i);
+    lake.volume += p[i];
+
+    for(auto& o: n){
+      int j = i+o;
+      if(!h.contains(j) || id[j] == l+1)
+        continue;
+
+      T surface = h[j] + p[j];
+
+      //Drainage Point
+      if(surface < lake.level - tolerance){
+        if(!lake.overflowing() || surface > lake.spill){
+          lake.spill = surface;
+          lake.drain = j;
+        }
+      }
+
+      //Rim
+      else if(surface > lake.level + tolerance)
+        push(lake, surface, j);
+
+      //Same Surface: Absorb older Lakes
+      else{
+        if(id[j] != 0)
+          drop(id[j]-1, h, p);
+        id[j] = l+1;
+        stack.push_back(j);
+      }
+    }
+  }
+}
+
+//Rim Cell at the Level joins the Lake
+template<typename T>
+void Lakes<T>::join(int l, int cell, Field<T>& h, Field<T>& p){
+
+  Lake<T>& lake = lakes[l];
+  id[cell] = l+1;
+  lake.cells.push_back(cell);
+
+  const int s = h.stride;
+  const int n[8] = {s, -s, 1, -1, s+1, -s-1, s-1, -s+1};
+
+  for(auto& o: n){
+    int j = cell+o;
+    if(!h.contains(j) || id[j] == l+1)
+      continue;
+
+    //Reached another Lake
+    if(id[j] != 0)
+      drop(id[j]-1, h, p);
+
+    T surface = h[j] + p[j];
+    if(surface < lake.level - tolerance){
+      if(!lake.overflowing() || surface > lake.spill){
+        lake.spill = surface;
+        lake.drain = j;
+      }
+    }
+    else push(lake, surface, j);
+  }
+}
+
+template<typename T>
+void Lakes<T>::push(Lake<T>& lake, T surface, int cell){
+  lake.rim.push_back({surface, cell});
+  std::push_heap(lake.rim.begin(), lake.rim.end(), std::greater<Rim<T>>());
+}
+
+template<typename T>
+void Lakes<T>::touch(int index, Field<T>& h, Field<T>& p, bool depth){
+
+  //Inside a Lake
+  int k = id[index]-1;
+  if(k >= 0){
+    Lake<T>& lake = lakes[k];
+    if(depth || h[index] > lake.level)
+      drop(k, h, p);
+    else{
+      lake.volume += (lake.level - h[index]) - p[index];
+      p[index] = lake.level - h[index];
+      return;
+    }
+  }
+
+  //On the Rim of a Lake
+  const int s = id.stride;
+  const int n[8] = {s, -s, 1, -1, s+1, -s-1, s-1, -s+1};
+  const T surface = h[index] + p[index];
+  for(auto& o: n){
+    int l = id[index+o]-1;
+    if(l < 0) continue;
+
+    Lake<T>& lake = lakes[l];
+
+    //Sank below the Surface: New or Moved Drain
+    if(surface < lake.level - tolerance){
+      if(!lake.overflowing() || surface > lake.spill || index == lake.drain){
+        lake.spill = surface;
+        lake.drain = index;
+      }
+    }
+
+    //Drain filled up: other Outlets are unknown
+    else if(index == lake.drain)
+      drop(l, h, p);
+
+    //Lower Rim Cells have to be Re-sorted now, Higher ones when they come up
+    else if(lake.rim.empty() || surface < lake.rim.front().surface)
+      push(lake, surface, index);
+  }
+}
+
+template<typename T>
+void Lakes<T>::flush(Field<T>& h, Field<T>& p){
+  for(auto& l: dirty)
+    if(lakes[l].dirty)
+      write(lakes[l], h, p);
+  dirty.clear();
+}
+
+template<typename T>
+void Lakes<T>::write(Lake<T>& lake, Field<T>& h, Field<T>& p){
+  lake.volume = T(0);
+  for(auto& i: lake.cells){
+    p[i] = (lake.level > h[i])?(lake.level - h[i]):T(0);
+    lake.volume += p[i];
+    written.mark(i);
+  }
+  lake.dirty = false;
+}
+
+template<typename T>
+void Lakes<T>::drop(int l, Field<T>& h, Field<T>& p){
+  Lake<T>& lake = lakes[l];
+  if(lake.dirty) write(lake, h, p);
+  for(auto& i: lake.cells)
+    id[i] = 0;
+  lake.cells.clear();
+  lake.rim.clear();
+  free.push_back(l);
+}
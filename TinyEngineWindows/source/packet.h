@@ -0,0 +1,342 @@
+#include <cmath>
+#include <limits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+===================================================
+          DROP PACKETS (SoA, AVX2)
+===================================================
+
+  Eight drops take one descend step at a time, one drop per lane of an AVX2
+  register. Position and speed are float lanes, volume and sediment are lanes
+  of T (one register of float, two of double, see Wide). The cells a step
+  reads (height and its normal stencil, pool, path, plant density) are
+  gathered for all lanes at once with _mm256_mask_i32gather_*, and the
+  mechanics and mass transfer are vector math with blends instead of
+  branches. A lane that left the mask gathers nothing and keeps its state.
+
+  The normal is computed from the gathered stencil instead of read from the
+  cache. It is the same arithmetic as surfaceNormal, so it equals the cached
+  value, and five gathers are cheaper than a cache gather plus a scalar fix
+  for every stale lane. Writes still stale the cache for other readers.
+
+  Writes stay scalar and go in lane order: path track, height, lake and
+  depression marks, stale normals. All lanes gather before any lane writes,
+  so two lanes on one cell see the same step, and the result is
+  deterministic. With one live lane a packet steps exactly like descend.
+
+  A lane whose drop stops descending (pool, stream, out of bounds, used up)
+  leaves the mask, and World::erodePacked hands it to the scalar flood path.
+  Without AVX2 (/arch:AVX2, -mavx2) SIMD is false and World::erode runs the
+  serial path instead.
+*/
+
+#ifdef __AVX2__
+
+//Eight Lanes of T; Masks are float Lanes with all Bits set
+template<typename T>
+struct Wide;
+
+template<>
+struct Wide<float>{
+  __m256 v;
+
+  static Wide set(float x){ return {_mm256_set1_ps(x)}; }
+  static Wide load(const float* p){ return {_mm256_loadu_ps(p)}; }
+  void store(float* p) const { _mm256_storeu_ps(p, v); }
+  static Wide gather(const float* base, __m256i index, __m256 mask){
+    return {_mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, index, mask, 4)};
+  }
+
+  static Wide from(__m256 f){ return {f}; }   //From float Lanes
+  __m256 floats() const { return v; }         //To float Lanes, rounded
+
+  static Wide blend(__m256 mask, Wide a, Wide b){ return {_mm256_blendv_ps(b.v, a.v, mask)}; }
+  static Wide max(Wide a, Wide b){ return {_mm256_max_ps(a.v, b.v)}; }   //(a > b)?a:b
+
+  friend Wide operator+(Wide a, Wide b){ return {_mm256_add_ps(a.v, b.v)}; }
+  friend Wide operator-(Wide a, Wide b){ return {_mm256_sub_ps(a.v, b.v)}; }
+  friend Wide operator*(Wide a, Wide b){ return {_mm256_mul_ps(a.v, b.v)}; }
+  friend Wide operator/(Wide a, Wide b){ return {_mm256_div_ps(a.v, b.v)}; }
+  friend __m256 operator>(Wide a, Wide b){ return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+};
+
+template<>
+struct Wide<double>{
+  __m256d lo, hi;                       //Lanes 0-3 and 4-7
+
+  static Wide set(double x){ __m256d s = _mm256_set1_pd(x); return {s, s}; }
+  static Wide load(const double* p){ return {_mm256_loadu_pd(p), _mm256_loadu_pd(p+4)}; }
+  void store(double* p) const { _mm256_storeu_pd(p, lo); _mm256_storeu_pd(p+4, hi); }
+  static Wide gather(const double* base, __m256i index, __m256 mask){
+    return {_mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm256_castsi256_si128(index), low(mask), 8),
+            _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm256_extracti128_si256(index, 1), high(mask), 8)};
+  }
+
+  static Wide from(__m256 f){
+    return {_mm256_cvtps_pd(_mm256_castps256_ps128(f)), _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1))};
+  }
+  __m256 floats() const { return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo)); }
+
+  static Wide blend(__m256 mask, Wide a, Wide b){
+    return {_mm256_blendv_pd(b.lo, a.lo, low(mask)), _mm256_blendv_pd(b.hi, a.hi, high(mask))};
+  }
+  static Wide max(Wide a, Wide b){ return {_mm256_max_pd(a.lo, b.lo), _mm256_max_pd(a.hi, b.hi)}; }
+
+  friend Wide operator+(Wide a, Wide b){ return {_mm256_add_pd(a.lo, b.lo), _mm256_add_pd(a.hi, b.hi)}; }
+  friend Wide operator-(Wide a, Wide b){ return {_mm256_sub_pd(a.lo, b.lo), _mm256_sub_pd(a.hi, b.hi)}; }
+  friend Wide operator*(Wide a, Wide b){ return {_mm256_mul_pd(a.lo, b.lo), _mm256_mul_pd(a.hi, b.hi)}; }
+  friend Wide operator/(Wide a, Wide b){ return {_mm256_div_pd(a.lo, b.lo), _mm256_div_pd(a.hi, b.hi)}; }
+  friend __m256 operator>(Wide a, Wide b){
+    return narrow(_mm256_cmp_pd(a.lo, b.lo, _CMP_GT_OQ), _mm256_cmp_pd(a.hi, b.hi, _CMP_GT_OQ));
+  }
+
+  //32 Bit Lane Masks to 64 Bit Halves, and back
+  static __m256d low(__m256 m){ return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(_mm256_castps_si256(m)))); }
+  static __m256d high(__m256 m){ return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(_mm256_castps_si256(m), 1))); }
+  static __m256 narrow(__m256d a, __m256d b){
+    const __m256i pick = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    __m256i x = _mm256_permutevar8x32_epi32(_mm256_castpd_si256(a), pick);
+    __m256i y = _mm256_permutevar8x32_epi32(_mm256_castpd_si256(b), pick);
+    return _mm256_castsi256_ps(_mm256_permute2x128_si256(x, y, 0x20));
+  }
+};
+
+template<typename T>
+struct DropPacket{
+
+  static const bool SIMD = true;
+  static const int N = 8;
+
+  //Hot State (Structure of Arrays)
+  float px[N], py[N];
+  float sx[N], sy[N];
+  T volume[N], sediment[N];
+  int live = 0;                         //Bit l: Lane l descends
+  Spans* spans = NULL;                  //Records the Cells written when set
+
+  const Drop<T> param = Drop<T>(glm::vec2(0.0)); //Shared Parameters
+
+  bool active(int l) const { return (live >> l) & 1; }
+  void load(int l, Drop<T>& drop);     //Lane l takes the Drop and goes live
+  void store(int l, Drop<T>& drop);
+  void step(Field<T>& h, Field<glm::vec3>& normals, Path<T>& path, Field<T>& pool, std::vector<int>& track, Field<T>& pd, T scale, Lakes<T>* lakes = NULL, Depressions<T>* spills = NULL, Scratch* scratch = NULL, Stats* stats = NULL);
+
+private:
+  typedef Wide<T> W;
+
+  //Lanes of a Bit Mask, and back
+  static __m256 lanes(int bits){
+    const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), bit), bit));
+  }
+  static int bits(__m256 mask){ return _mm256_movemask_ps(mask); }
+  static int count(int bits){ int n = 0; for(; bits; bits &= bits-1) n++; return n; }
+
+  //Index of the Cell under the Positions
+  static __m256i cell(__m256 x, __m256 y, __m256i stride){
+    return _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(x), stride), _mm256_cvttps_epi32(y));
+  }
+
+  //Path Value (see Path::operator[])
+  static W stream(const Path<T>& p, __m256i i, __m256 mask){
+    const __m256i stamp = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)&p.stamp[0], i, _mm256_castps_si256(mask), 4);
+    const __m256i k = _mm256_sub_epi32(_mm256_set1_epi32((int)p.epoch), stamp);
+    const __m256i last = _mm256_set1_epi32((int)Path<T>::HISTORY-1);
+    const __m256 recent = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_min_epu32(k, last), k)));
+    return W::gather(&p.value[0], i, recent)*W::gather(p.decay.data(), k, recent);
+  }
+
+  //A Value compares to the double c like to these: (v > c) == (v > below(c))
+  template<typename S>
+  static S below(double c){ S s = (S)c; return ((double)s > c)?std::nextafter(s, -std::numeric_limits<S>::infinity()):s; }
+  template<typename S>
+  static S above(double c){ S s = (S)c; return ((double)s < c)?std::nextafter(s, std::numeric_limits<S>::infinity()):s; }
+};
+
+template<typename T>
+void DropPacket<T>::load(int l, Drop<T>& drop){
+  px[l] = drop.pos.x;
+  py[l] = drop.pos.y;
+  sx[l] = drop.speed.x;
+  sy[l] = drop.speed.y;
+  volume[l] = drop.volume;
+  sediment[l] = drop.sediment;
+  live |= 1 << l;
+}
+
+template<typename T>
+void DropPacket<T>::store(int l, Drop<T>& drop){
+  drop.pos = glm::vec2(px[l], py[l]);
+  drop.speed = glm::vec2(sx[l], sy[l]);
+  drop.volume = volume[l];
+  drop.sediment = sediment[l];
+}
+
+/*
+  The operations follow descend and surfaceNormal one by one (T where they
+  use T, float where they use float), including the products with 0 and 1
+  of the cross products, so every lane rounds like the scalar step.
+*/
+
+template<typename T>
+void DropPacket<T>::step(Field<T>& h, Field<glm::vec3>& normals, Path<T>& p, Field<T>& b, std::vector<int>& track, Field<T>& pd, T scale, Lakes<T>* lakes, Depressions<T>* spills, Scratch* scratch, Stats* stats){
+
+  const __m256 alive = lanes(live);
+  const __m256i stride = _mm256_set1_epi32(h.stride);
+  const __m256 dt = _mm256_set1_ps(param.dt);
+  const W dT = W::set((T)param.dt);
+  const W one = W::set(T(1));
+
+  __m256 x = _mm256_loadu_ps(px), y = _mm256_loadu_ps(py);
+  __m256 vx = _mm256_loadu_ps(sx), vy = _mm256_loadu_ps(sy);
+  W vol = W::load(volume), sed = W::load(sediment);
+
+  //Current Cell, added to the Path
+  const __m256i ind = cell(x, y, stride);
+  alignas(32) int at[N];
+  _mm256_store_si256((__m256i*)at, ind);
+  for(int l = 0; l < N; l++)
+    if(active(l)) p.visit(at[l], track);
+
+  //Surface Normal from the Stencil (x and z, y is 4 before normalizing)
+  const T* hd = &h[0];
+  const W h0 = W::gather(hd, ind, alive);
+  const W s = W::set(scale);
+  const __m256 dy1 = (s*(W::gather(hd, _mm256_add_epi32(ind, _mm256_set1_epi32(1)), alive) - h0)).floats();
+  const __m256 dx1 = (s*(W::gather(hd, _mm256_add_epi32(ind, stride), alive) - h0)).floats();
+  const __m256 dy2 = (s*(W::gather(hd, _mm256_sub_epi32(ind, _mm256_set1_epi32(1)), alive) - h0)).floats();
+  const __m256 dx2 = (s*(W::gather(hd, _mm256_sub_epi32(ind, stride), alive) - h0)).floats();
+
+  const __m256 z = _mm256_setzero_ps(), u = _mm256_set1_ps(1.0f), m1 = _mm256_set1_ps(-1.0f);
+  #define MUL _mm256_mul_ps
+  #define SUB _mm256_sub_ps
+  #define ADD _mm256_add_ps
+  __m256 nx = SUB(MUL(dy1, z), MUL(dx1, u));                 //cross((0,dy1,1), (1,dx1,0))
+  __m256 nz = SUB(MUL(z, dx1), MUL(u, dy1));
+  nx = ADD(nx, SUB(MUL(dy2, z), MUL(dx2, m1)));             //cross((0,dy2,-1), (-1,dx2,0))
+  nz = ADD(nz, SUB(MUL(z, dx2), MUL(m1, dy2)));
+  nx = ADD(nx, SUB(MUL(dx1, m1), MUL(dy2, z)));             //cross((1,dx1,0), (0,dy2,-1))
+  nz = ADD(nz, SUB(MUL(u, dy2), MUL(z, dx1)));
+  nx = ADD(nx, SUB(MUL(dx2, u), MUL(dy1, z)));              //cross((-1,dx2,0), (0,dy1,1))
+  nz = ADD(nz, SUB(MUL(m1, dy1), MUL(z, dx2)));
+  const __m256 ny = _mm256_set1_ps(4.0f);
+  const __m256 inv = _mm256_div_ps(u, _mm256_sqrt_ps(ADD(ADD(MUL(nx, nx), MUL(ny, ny)), MUL(nz, nz))));
+  nx = MUL(nx, inv);
+  nz = MUL(nz, inv);
+
+  //Effective Parameter Set
+  const W pi = stream(p, ind, alive);
+  const W effD = W::set(param.depositionRate)*W::max(W::set(T(0)), one - W::gather(&pd[0], ind, alive));
+  const W effF = W::set(param.friction)*(one - W::set(T(0.5))*pi);
+  const W effR = W::set(param.evapRate)*(one - W::set(T(0.2))*pi);
+
+  //Newtonian Mechanics
+  const __m256 mass = (vol*W::set(param.density)).floats();
+  const __m256 ax = _mm256_div_ps(nx, mass);
+  const __m256 ay = _mm256_div_ps(nz, mass);
+  __m256 nvx = ADD(vx, MUL(dt, ax));
+  __m256 nvy = ADD(vy, MUL(dt, ay));
+  const __m256 nx2 = ADD(x, MUL(dt, nvx));
+  const __m256 ny2 = ADD(y, MUL(dt, nvy));
+  const __m256 f = (one - dT*effF).floats();
+  nvx = MUL(nvx, f);
+  nvy = MUL(nvy, f);
+
+  x = _mm256_blendv_ps(x, nx2, alive);
+  y = _mm256_blendv_ps(y, ny2, alive);
+  vx = _mm256_blendv_ps(vx, nvx, alive);
+  vy = _mm256_blendv_ps(vy, nvy, alive);
+
+  //Out-Of-Bounds
+  const __m256i ix = _mm256_cvttps_epi32(x), iy = _mm256_cvttps_epi32(y);
+  const __m256 inb = _mm256_and_ps(
+    _mm256_and_ps(_mm256_cmp_ps(x, z, _CMP_GE_OQ), _mm256_cmp_ps(y, z, _CMP_GE_OQ)),
+    _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(h.dim.x), ix),
+                                         _mm256_cmpgt_epi32(_mm256_set1_epi32(h.dim.y), iy))));
+  const __m256 reach = _mm256_and_ps(alive, inb);
+
+  //New Cell
+  const __m256i nind = _mm256_add_epi32(_mm256_mullo_epi32(ix, stride), iy);
+  const W hn = W::gather(hd, nind, reach);
+  const W pn = stream(p, nind, reach);
+  const W bn = W::gather(&b[0], nind, reach);
+
+  //Particle is not accelerated, or enters Pool
+  const __m256 len = _mm256_sqrt_ps(ADD(MUL(ax, ax), MUL(ay, ay)));
+  const __m256 still = _mm256_and_ps(pn > W::set(below<T>(0.3)), _mm256_cmp_ps(len, _mm256_set1_ps(above<float>(0.01)), _CMP_LT_OQ));
+  const __m256 enters = _mm256_andnot_ps(still, bn > W::set(T(0)));
+  const __m256 go = _mm256_andnot_ps(_mm256_or_ps(still, enters), reach);
+
+  if(stats){
+    stats->steps += count(live);
+    stats->outofbounds += count(bits(_mm256_andnot_ps(inb, alive)));
+    stats->poolentries += count(bits(_mm256_and_ps(enters, reach)));
+  }
+
+  //Mass-Transfer and Evaporation
+  const __m256 speed = _mm256_sqrt_ps(ADD(MUL(vx, vx), MUL(vy, vy)));
+  const W cdiff = W::max(W::set(T(0)), W::from(speed)*(h0 - hn)) - sed;
+  const W dh = vol*dT*effD*cdiff;
+  const W evap = one - dT*effR;
+  const W nvol = vol*evap;
+  sed = W::blend(go, (sed + dT*effD*cdiff)/evap, sed);
+  vol = W::blend(go, nvol, W::blend(_mm256_andnot_ps(inb, alive), W::set(T(0)), vol));
+  #undef MUL
+  #undef SUB
+  #undef ADD
+
+  //Entered a new Block: page in the next one along the Speed
+  if(scratch){
+    alignas(32) float fx[N], fy[N], fvx[N], fvy[N];
+    _mm256_store_ps(fx, x); _mm256_store_ps(fy, y);
+    _mm256_store_ps(fvx, vx); _mm256_store_ps(fvy, vy);
+    const int inside = bits(reach);
+    for(int l = 0; l < N; l++){
+      glm::ivec2 pos = glm::ivec2(glm::vec2(fx[l], fy[l]));
+      if(!((inside >> l) & 1) || pos/Scratch::block() == glm::ivec2(glm::vec2(px[l], py[l]))/Scratch::block()) continue;
+      glm::ivec2 next = (pos/Scratch::block() + glm::ivec2(glm::sign(glm::vec2(fvx[l], fvy[l]))))*Scratch::block();
+      scratch->ahead(next, next + Scratch::block());
+    }
+  }
+
+  //Scatter in Lane Order
+  alignas(32) T lost[N];
+  dh.store(lost);
+  const int writes = bits(go);
+  for(int l = 0; l < N; l++){
+    if(!((writes >> l) & 1)) continue;
+    h[at[l]] -= lost[l];
+    if(spans) spans->mark(at[l]);
+    if(lakes) lakes->touch(at[l], h, b);
+    if(spills) spills->touch(at[l]);
+    staleNormal(at[l], normals);
+  }
+
+  _mm256_storeu_ps(px, x);
+  _mm256_storeu_ps(py, y);
+  _mm256_storeu_ps(sx, vx);
+  _mm256_storeu_ps(sy, vy);
+  vol.store(volume);
+  sed.store(sediment);
+  live = bits(_mm256_and_ps(go, nvol > W::set(param.minVol)));
+}
+
+#else
+
+//No AVX2 in this Build: World::erode runs the serial Path
+template<typename T>
+struct DropPacket{
+  static const bool SIMD = false;
+  static const int N = 1;
+  int live = 0;
+  Spans* spans = NULL;
+  bool active(int) const { return false; }
+  void load(int, Drop<T>&){}
+  void store(int, Drop<T>&){}
+  void step(Field<T>&, Field<glm::vec3>&, Path<T>&, Field<T>&, std::vector<int>&, Field<T>&, T, Lakes<T>* = NULL, Depressions<T>* = NULL, Scratch* = NULL, Stats* = NULL){}
+};
+
+#endif
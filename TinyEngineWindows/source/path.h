@@ -0,0 +1,122 @@
+#include <vector>
+
+/*
+  Water Path: a moving average over erosion calls of whether a drop passed a
+  cell. Each call decays every cell by (1-rate) and adds rate to the cells in
+  its track. Only tracked cells are written: a cell keeps its value and the
+  epoch it was written in, and a read applies the decay of the calls since.
+  Past HISTORY calls the decay is below 1E-17 and the cell reads as zero.
+
+  Drops record a cell once per call in a track list. Lists of concurrent
+  tiles never share a cell, since their regions are disjoint.
+*/
+
+template<typename T>
+class Path{
+public:
+  void resize(glm::ivec2 dim, Scratch* scratch = NULL);
+  void clear();
+
+  //Current Value (Decayed to the Epoch)
+  T operator[](int i) const {
+    unsigned int k = epoch - stamp[i];
+    return (k < HISTORY)?value[i]*decay[k]:T(0);
+  }
+
+  //Record a Cell in this Call's Track
+  void visit(int i, std::vector<int>& track){
+    if(mark[i] == epoch+1) return;
+    mark[i] = epoch+1;
+    track.push_back(i);
+  }
+
+  void update(std::vector<int>& track);   //Close the Call: Decay and add the Track
+  Field<T>& bake();                       //All Cells at the Epoch, O(map)
+  const T* bake(int i, int n);            //Cells [i, i+n) of a Row at the Epoch
+  Field<T>& restore(glm::ivec2 dim, unsigned int calls, Scratch* scratch = NULL);  //Stamps for baked Values put into the Field
+  size_t bytes() const { return value.bytes() + stamp.bytes() + mark.bytes(); }
+
+  T rate = 0.01;                          //Weight of the newest Call
+  unsigned int epoch = 0;                 //Finished Calls
+
+  static const unsigned int HISTORY = 4096;
+
+private:
+  Field<T> value;                         //Value when last written
+  Field<unsigned int> stamp;              //Epoch of the last Write
+  Field<unsigned int> mark;               //Epoch+1 once tracked in this Call
+  std::vector<T> decay;                   //(1-rate)^k
+  void tabulate();
+
+  template<typename> friend struct DropPacket;   //Gathers Value, Stamp and Decay
+};
+
+template<typename T>
+void Path<T>::resize(glm::ivec2 dim, Scratch* scratch){
+  Scratch::resize(value, dim, scratch);
+  Scratch::resize(stamp, dim, scratch);
+  Scratch::resize(mark, dim, scratch);
+  clear();
+}
+
+template<typename T>
+void Path<T>::clear(){
+  value.clear();
+  stamp.clear();
+  mark.clear();
+  epoch = 0;
+  tabulate();
+}
+
+template<typename T>
+void Path<T>::tabulate(){
+  decay.resize(HISTORY);
+  decay[0] = T(1);
+  for(unsigned int k = 1; k < HISTORY; k++)
+    decay[k] = decay[k-1]*(T(1)-rate);
+}
+
+template<typename T>
+void Path<T>::update(std::vector<int>& track){
+  for(auto& i: track){
+    value[i] = (T(1)-rate)*(*this)[i] + rate;
+    stamp[i] = epoch+1;
+  }
+  epoch++;
+  track.clear();
+}
+
+template<typename T>
+Field<T>& Path<T>::bake(){
+  for(int i = 0; i < value.size(); i++){
+    value[i] = (*this)[i];
+    stamp[i] = epoch;
+  }
+  return value;
+}
+
+template<typename T>
+const T* Path<T>::bake(int i, int n){
+  for(int k = i; k < i+n; k++){
+    value[k] = (*this)[k];
+    stamp[k] = epoch;
+  }
+  return &value[i];
+}
+
+/*
+  A loaded snapshot holds values baked at the epoch calls, so every cell is
+  stamped with it. The value field is left for the loader to fill or view
+  (see archive.h).
+*/
+
+template<typename T>
+Field<T>& Path<T>::restore(glm::ivec2 dim, unsigned int calls, Scratch* scratch){
+  Scratch::resize(stamp, dim, scratch);
+  Scratch::resize(mark, dim, scratch);
+  epoch = calls;
+  for(int i = 0; i < stamp.size(); i++)
+    stamp[i] = epoch;
+  tabulate();
+  return value;
+}
@@ -0,0 +1,603 @@
+#include "world.h"
+#include "simulation.h"
+#include "chunks.h"
+
+/*
+===================================================
+                RENDERING STUFF
+===================================================
+*/
+
+World<scalar> world;
+Simulation<scalar> simulation(world);   //Erodes on a Worker Thread (see simulation.h)
+
+int WIDTH = 1000;
+int HEIGHT = 1000;
+
+float zoom = 0.2;
+float zoomInc = 20.0;
+
+//Rotation and View
+float rotation = 0.0f;
+glm::vec3 cameraPos = glm::vec3(50, 50, 50);
+glm::vec3 lookPos = glm::vec3(0, 0, 0);
+glm::mat4 camera = glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0));
+glm::mat4 projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
+
+glm::vec3 viewPos = glm::vec3(world.dim.x/2.0, world.scale/2.0, world.dim.y/2.0);
+
+//Shader Stuff
+float steepness = 0.8;
+glm::vec3 flatColor = glm::vec3(0.40, 0.60, 0.25);
+glm::vec3 waterColor = glm::vec3(0.17, 0.40, 0.44);
+glm::vec3 steepColor = glm::vec3(0.7);
+//glm::vec3 steepColor = glm::vec3(0.78, 0.6, 0.168);
+//glm::vec3 flatColor = glm::vec3(0.84, 0.65, 0.36);
+
+//Lighting and Shading
+glm::vec3 skyCol = glm::vec4(0.64, 0.75, 0.9, 1.0f);
+glm::vec3 lightPos = glm::vec3(-100.0f, 100.0f, -150.0f);
+glm::vec3 lightCol = glm::vec3(1.0f, 1.0f, 0.9f);
+float lightStrength = 1.4;
+glm::mat4 depthModelMatrix = glm::mat4(1.0);
+glm::mat4 depthProjection = glm::ortho<float>(-300, 300, -300, 300, 0, 800);
+glm::mat4 depthCamera = glm::lookAt(lightPos, glm::vec3(0), glm::vec3(0,1,0));
+bool viewmap = true;
+enum Meshing{ QUADS, GRID, DISPLACE };
+Meshing meshing = DISPLACE;             //Terrain: Quad Mesh, Packed Grid or Displaced on the GPU
+
+glm::mat4 biasMatrix = glm::mat4(
+    0.5, 0.0, 0.0, 0.0,
+    0.0, 0.5, 0.0, 0.0,
+    0.0, 0.0, 0.5, 0.0,
+    0.5, 0.5, 0.5, 1.0
+);
+
+/*
+  Terrain Mesh: two triangles per cell, raised by the pool depth. M is the
+  Model or any type with the same vertex vectors, so the mesher also runs
+  without a GL context (see HydrologyBench.cpp). W is a World or a Snapshot.
+
+  Every quad owns six vertices at a fixed place, quad (i, j) starting at
+  vertex 6*(i*(dim.y-1)+j), so remesh() can rewrite single quads in place.
+*/
+
+template<typename M, typename W>
+void quad(M* m, W& world, int i, int j, size_t v){
+
+  const int s = world.heightmap.stride;
+
+  //Get Index
+  int ind = world.heightmap.index(glm::ivec2(i, j));
+
+  //Add to Position Vector
+  glm::vec3 a = glm::vec3(i, world.scale*world.heightmap[ind], j);
+  glm::vec3 b = glm::vec3(i+1, world.scale*world.heightmap[ind+s], j);
+  glm::vec3 c = glm::vec3(i, world.scale*world.heightmap[ind+1], j+1);
+  glm::vec3 d = glm::vec3(i+1, world.scale*world.heightmap[ind+s+1], j+1);
+
+  //Check if the Surface is Water
+  bool water1 = (world.waterpool[ind] > 0.0 &&
+                 world.waterpool[ind+s] > 0.0 &&
+                 world.waterpool[ind+1] > 0.0);
+
+  bool water2 = (world.waterpool[ind+s] > 0.0 &&
+                 world.waterpool[ind+1] > 0.0 &&
+                 world.waterpool[ind+s+1] > 0.0);
+
+  //Add the Pool Height
+  a += glm::vec3(0.0, world.scale*world.waterpool[ind], 0.0);
+  b += glm::vec3(0.0, world.scale*world.waterpool[ind+s], 0.0);
+  c += glm::vec3(0.0, world.scale*world.waterpool[ind+1], 0.0);
+  d += glm::vec3(0.0, world.scale*world.waterpool[ind+s+1], 0.0);
+
+  //Get the Color of the Ground (Water vs. Flat)
+  auto p = world.waterpath[ind];
+  glm::vec3 color1 = (water1)?waterColor:glm::mix(flatColor, waterColor, p);
+  glm::vec3 color2 = (water2)?waterColor:glm::mix(flatColor, waterColor, p);
+
+  //Upper (a, b, c) and Lower Triangle (d, c, b)
+  glm::vec3 n1 = glm::normalize(glm::cross(a-b, c-b));
+  glm::vec3 n2 = glm::normalize(glm::cross(d-c, b-c));
+  if(n1.y < steepness && !water1) color1 = steepColor;
+  if(n2.y < steepness && !water2) color2 = steepColor;
+
+  const glm::vec3 corner[6] = {a, b, c, d, c, b};
+  for(int k = 0; k < 6; k++){
+    glm::vec3 n = (k < 3)?n1:n2;
+    glm::vec3 color = (k < 3)?color1:color2;
+
+    GLfloat* position = &m->positions[3*(v+k)];
+    GLfloat* normal = &m->normals[3*(v+k)];
+    GLfloat* rgba = &m->colors[4*(v+k)];
+    position[0] = corner[k].x; position[1] = corner[k].y; position[2] = corner[k].z;
+    normal[0] = n.x; normal[1] = n.y; normal[2] = n.z;
+    rgba[0] = color.x; rgba[1] = color.y; rgba[2] = color.z; rgba[3] = 1.0;
+  }
+}
+
+template<typename M, typename W>
+void mesh(M* m, W& world){
+
+  const int rows = std::max(world.dim.x-1, 0);
+  const int cols = std::max(world.dim.y-1, 0);
+  const size_t n = 6*(size_t)rows*cols;
+
+  //Size the Containers, the Indices never change
+  m->positions.resize(3*n);
+  m->normals.resize(3*n);
+  m->colors.resize(4*n);
+  m->indices.resize(n);
+  for(size_t k = 0; k < n; k++)
+    m->indices[k] = k;
+
+  //Loop over all positions and add the triangles!
+  for(int i = 0; i < rows; i++)
+    for(int j = 0; j < cols; j++)
+      quad(m, world, i, j, 6*((size_t)i*cols+j));
+}
+
+/*
+  Rebuilds the quads on the dirty cells of a snapshot. A cell is a corner of
+  the quads left of and above it. ranges gets the rewritten vertex ranges
+  (first, count); rows less than a row apart share one range.
+*/
+
+template<typename M, typename W>
+void remesh(M* m, W& world, std::vector<glm::ivec2>& ranges){
+
+  ranges.clear();
+  const int rows = world.dim.x-1;
+  const int cols = world.dim.y-1;
+
+  for(int i = 0; i < rows; i++){
+
+    //Cells of Rows i and i+1 are Corners of Quad Row i
+    glm::ivec2 a = world.dirty[i];
+    glm::ivec2 b = world.dirty[i+1];
+    if(a.x > a.y && b.x > b.y) continue;
+    int lo = std::max(std::min(a.x, b.x)-1, 0);
+    int hi = std::min(std::max(a.y, b.y), cols-1);
+    if(lo > hi) continue;
+
+    for(int j = lo; j <= hi; j++)
+      quad(m, world, i, j, 6*((size_t)i*cols+j));
+
+    int first = 6*(i*cols+lo);
+    int count = 6*(hi-lo+1);
+    if(!ranges.empty() && first - (ranges.back().x + ranges.back().y) <= 6*cols)
+      ranges.back().y = first + count - ranges.back().x;
+    else ranges.push_back(glm::ivec2(first, count));
+  }
+}
+
+/*
+  Shared-Vertex Terrain Grid: one packed vertex per cell (height, normal,
+  color) drawn as a single triangle strip, with a degenerate join between
+  rows. The shader (terrain.vs) places a vertex by its index, so it stores
+  no x and z. Triangles wind like the quad mesh above.
+
+  Normals are central differences of the water surface, stored octahedral in
+  two shorts. The color alpha flags water; water faces are flat shaded and
+  steep slopes colored in terrain.fs.
+*/
+
+inline void octahedral(glm::vec3 n, GLshort* e){
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 o = glm::vec2(n.x, n.z);
+  if(n.y < 0.0f)  //Fold the lower Hemisphere
+    o = (1.0f - glm::abs(glm::vec2(n.z, n.x)))*glm::vec2((n.x >= 0.0f)?1.0f:-1.0f, (n.z >= 0.0f)?1.0f:-1.0f);
+  e[0] = (GLshort)std::round(glm::clamp(o.x, -1.0f, 1.0f)*32767.0f);
+  e[1] = (GLshort)std::round(glm::clamp(o.y, -1.0f, 1.0f)*32767.0f);
+}
+
+template<typename G, typename W>
+void vertex(G* g, W& world, int i, int j){
+
+  const glm::ivec2 dim = world.dim;
+  auto surface = [&](int x, int y){
+    int k = world.heightmap.index(glm::ivec2(x, y));
+    return (float)(world.scale*(world.heightmap[k] + world.waterpool[k]));
+  };
+
+  //Central Differences, One-Sided at the Edge
+  const int x0 = std::max(i-1, 0), x1 = std::min(i+1, dim.x-1);
+  const int y0 = std::max(j-1, 0), y1 = std::min(j+1, dim.y-1);
+  float dx = (surface(x1, j) - surface(x0, j))/(float)(x1-x0);
+  float dz = (surface(i, y1) - surface(i, y0))/(float)(y1-y0);
+  glm::vec3 n = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+  //Color of the Ground (Water vs. Flat)
+  int ind = world.heightmap.index(glm::ivec2(i, j));
+  bool water = (world.waterpool[ind] > 0.0);
+  glm::vec3 color = (water)?waterColor:glm::mix(flatColor, waterColor, (float)world.waterpath[ind]);
+
+  auto& v = g->vertices[(size_t)i*dim.y+j];
+  v.height = surface(i, j);
+  octahedral(n, v.normal);
+  v.color[0] = (GLubyte)(255.0f*glm::clamp(color.x, 0.0f, 1.0f) + 0.5f);
+  v.color[1] = (GLubyte)(255.0f*glm::clamp(color.y, 0.0f, 1.0f) + 0.5f);
+  v.color[2] = (GLubyte)(255.0f*glm::clamp(color.z, 0.0f, 1.0f) + 0.5f);
+  v.color[3] = (water)?255:0;
+}
+
+template<typename G>
+void strip(G* g, glm::ivec2 dim){
+  g->dim = dim;
+  g->indices.clear();
+  for(int i = 0; i+1 < dim.x; i++){
+    if(i > 0) g->indices.push_back(i*dim.y);                  //Degenerate Join
+    for(int j = 0; j < dim.y; j++){
+      g->indices.push_back(i*dim.y+j);
+      g->indices.push_back((i+1)*dim.y+j);
+    }
+    if(i+2 < dim.x) g->indices.push_back((i+2)*dim.y-1);
+  }
+}
+
+template<typename G, typename W>
+void grid(G* g, W& world){
+
+  const glm::ivec2 dim = world.dim;
+
+  //Strip Indices only depend on the Size
+  if(g->dim != dim){
+    strip(g, dim);
+    g->vertices.resize((size_t)dim.x*dim.y);
+  }
+
+  if(dim.x < 2 || dim.y < 2) return;
+  for(int i = 0; i < dim.x; i++)
+    for(int j = 0; j < dim.y; j++)
+      vertex(g, world, i, j);
+}
+
+/*
+  Rebuilds the grid vertices on and around the dirty cells of a snapshot,
+  since a normal reads the neighbors. ranges works as in remesh().
+*/
+
+template<typename G, typename W>
+void regrid(G* g, W& world, std::vector<glm::ivec2>& ranges){
+
+  ranges.clear();
+  const glm::ivec2 dim = world.dim;
+  if(dim.x < 2 || dim.y < 2) return;
+
+  for(int i = 0; i < dim.x; i++){
+
+    int lo = dim.y, hi = -1;
+    for(int k = std::max(i-1, 0); k <= std::min(i+1, dim.x-1); k++){
+      lo = std::min(lo, world.dirty[k].x);
+      hi = std::max(hi, world.dirty[k].y);
+    }
+    if(lo > hi) continue;
+    lo = std::max(lo-1, 0);
+    hi = std::min(hi+1, dim.y-1);
+
+    for(int j = lo; j <= hi; j++)
+      vertex(g, world, i, j);
+
+    int first = i*dim.y+lo;
+    int count = hi-lo+1;
+    if(!ranges.empty() && first - (ranges.back().x + ranges.back().y) <= dim.y)
+      ranges.back().y = first + count - ranges.back().x;
+    else ranges.push_back(glm::ivec2(first, count));
+  }
+}
+
+/*
+  GPU Displacement: displace.vs reads heights, pools and the path from three
+  float textures (see Texture::floats) and places, shades and colors every
+  vertex of the chunk patches (see chunks.h). A snapshot uploads its dirty
+  rows, in runs of consecutive rows.
+*/
+
+template<typename X, typename T>
+void upload(X& texture, Field<T>& field, int first, int count, std::vector<GLfloat>& rows){
+  const int cols = field.dim.y;
+  rows.resize((size_t)count*cols);
+  for(int i = 0; i < count; i++){
+    const T* row = &field[field.index(glm::ivec2(first+i, 0))];
+    for(int j = 0; j < cols; j++)
+      rows[(size_t)i*cols+j] = (GLfloat)row[j];
+  }
+  texture.rows(first, count, cols, rows.data());
+}
+
+//fields: Height, Pool and Path Texture
+template<typename X, typename W>
+void upload(X* fields, W& world, bool full, std::vector<GLfloat>& rows){
+
+  const glm::ivec2 dim = world.dim;
+  if(full)
+    for(int k = 0; k < 3; k++)
+      fields[k].floats(dim.y, dim.x);
+
+  int first = -1;
+  for(int i = 0; i <= dim.x; i++){
+    bool dirty = (i < dim.x) && (full || world.dirty[i].x <= world.dirty[i].y);
+    if(dirty && first < 0) first = i;
+    if(dirty || first < 0) continue;
+    upload(fields[0], world.heightmap, first, i-first, rows);
+    upload(fields[1], world.waterpool, first, i-first, rows);
+    upload(fields[2], world.waterpath, first, i-first, rows);
+    first = -1;
+  }
+}
+
+/*
+  Minimap: the hydromap colors of a snapshot in a persistent RGBA buffer, one
+  pixel row per field row. Only dirty rows are recolored and uploaded, in runs
+  of consecutive rows (see Texture::pixels). The kernel is hydromap written
+  out per channel, so a row is one vector loop, without a call per pixel.
+*/
+
+template<typename T>
+void colorize(Field<T>& path, Field<T>& pool, int row, GLubyte* pixels){
+  const T* t1 = &path[path.index(glm::ivec2(row, 0))];
+  const T* t2 = &pool[pool.index(glm::ivec2(row, 0))];
+  for(int y = 0; y < path.dim.y; y++){
+    const float a = (float)t1[y];
+    const float d = (float)t2[y];
+    const float b = (d > 0.0f)?1.0f - 5.0f*d/(1.0f + 5.0f*d):0.0f;  //1 - langmuir(d, 5)
+    pixels[4*y+0] = (GLubyte)(255.0f*(0.2f*a*(1.0f-b) + 0.15f*b));
+    pixels[4*y+1] = (GLubyte)(255.0f*(0.5f*a*(1.0f-b) + 0.15f*b));
+    pixels[4*y+2] = (GLubyte)(255.0f*(a*(1.0f-b) + 0.45f*b));
+    pixels[4*y+3] = 255;
+  }
+}
+
+template<typename X, typename W>
+void minimap(X& texture, W& world, bool full, std::vector<GLubyte>& pixels){
+
+  const glm::ivec2 dim = world.dim;
+  if(full){
+    texture.rgba(dim.y, dim.x);
+    pixels.resize((size_t)dim.x*dim.y*4);
+  }
+
+  int first = -1;
+  for(int i = 0; i <= dim.x; i++){
+    bool dirty = (i < dim.x) && (full || world.dirty[i].x <= world.dirty[i].y);
+    if(dirty) colorize(world.waterpath, world.waterpool, i, &pixels[(size_t)i*dim.y*4]);
+    if(dirty && first < 0) first = i;
+    if(dirty || first < 0) continue;
+    texture.pixels(first, i-first, dim.y, &pixels[(size_t)first*dim.y*4]);
+    first = -1;
+  }
+}
+
+/*
+  Forest: trees as instanced sprites (see Sprites), one vec4 per tree with the
+  top of its trunk and its size, in a slot it keeps while it lives. Sprites
+  turn to the camera or the light in sprite.vs / spritedepth.vs.
+
+  Tree handles rise along the list (see Plants), so a merge of the handles
+  of this and the last snapshot pairs up the survivors. Dead trees free
+  their slot (size 0 draws nothing), newborns take free slots. Every slot
+  is compared with its new value, and only changed slots are uploaded, in
+  runs of consecutive slots.
+*/
+
+struct Forest{
+  std::vector<unsigned int> ids;        //Trees of the last Snapshot
+  std::vector<int> slots;
+  std::vector<unsigned int> nextids;
+  std::vector<int> nextslots;
+  std::vector<glm::vec4> instances;     //Slot Contents, as in the Buffer
+  std::vector<char> dirty;
+  std::vector<int> free;
+};
+
+template<typename X, typename W>
+void plant(X& sprites, Forest& f, W& world){
+
+  auto write = [&](int slot, glm::vec4 v){
+    if(f.instances[slot] == v) return;
+    f.instances[slot] = v;
+    f.dirty[slot] = 1;
+  };
+  auto release = [&](int slot){
+    write(slot, glm::vec4(0.0f));
+    f.free.push_back(slot);
+  };
+
+  auto& trees = world.trees;
+  f.nextids.clear();
+  f.nextslots.clear();
+  size_t j = 0;
+  for(size_t i = 0; i < trees.count(); i++){
+
+    const unsigned int id = trees.id[i];
+    while(j < f.ids.size() && f.ids[j] < id)
+      release(f.slots[j++]);
+
+    int slot;
+    if(j < f.ids.size() && f.ids[j] == id) slot = f.slots[j++];
+    else if(!f.free.empty()){
+      slot = f.free.back();
+      f.free.pop_back();
+    }
+    else {
+      slot = f.instances.size();
+      f.instances.push_back(glm::vec4(0.0f));
+      f.dirty.push_back(1);
+    }
+
+    const glm::vec2 p = trees.pos[i];
+    const float size = trees.size[i];
+    write(slot, glm::vec4(p.x, size + world.scale*world.heightmap[trees.index[i]], p.y, size));
+    f.nextids.push_back(id);
+    f.nextslots.push_back(slot);
+  }
+  while(j < f.ids.size())
+    release(f.slots[j++]);
+  std::swap(f.ids, f.nextids);
+  std::swap(f.slots, f.nextslots);
+
+  //Grow the Buffer with Room to spare, or upload the changed Runs
+  const size_t n = f.instances.size();
+  sprites.count = n;
+  if(n > sprites.capacity){
+    sprites.reserve(std::max(2*n, (size_t)1024), n, f.instances.data());
+    std::fill(f.dirty.begin(), f.dirty.end(), 0);
+    return;
+  }
+  size_t first = n;
+  for(size_t i = 0; i <= n; i++){
+    bool changed = (i < n) && f.dirty[i];
+    if(changed && first == n) first = i;
+    if(changed || first == n) continue;
+    sprites.update(first, i-first, &f.instances[first]);
+    std::fill(f.dirty.begin()+first, f.dirty.begin()+i, 0);
+    first = n;
+  }
+}
+
+std::function<void(Model* m)> constructor = [&](Model* m){
+  mesh(m, simulation.current());
+};
+
+std::function<void(Grid* g)> gridder = [&](Grid* g){
+  grid(g, simulation.current());
+};
+
+std::function<void()> eventHandler = [&](){
+
+  if(!Tiny::event.scroll.empty()){
+
+    if(Tiny::event.scroll.back().wheel.y > 0.99 && zoom <= 0.3){
+      zoom /= 0.975;
+      projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
+    }
+    else if(Tiny::event.scroll.back().wheel.y < -0.99 && zoom > 0.005){
+      zoom *= 0.975;
+      projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
+    }
+    else if(Tiny::event.scroll.back().wheel.x < -0.8){
+      rotation += 1.5f;
+      camera = glm::rotate(camera, glm::radians(1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    else if(Tiny::event.scroll.back().wheel.x > 0.8){
+      rotation -= 1.5f;
+      camera = glm::rotate(camera, glm::radians(-1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    //Adjust Stuff
+    if(rotation < 0.0) rotation = 360.0 + rotation;
+    else if(rotation > 360.0) rotation = rotation - 360.0;
+    camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
+    Tiny::event.scroll.pop_back();
+  }
+
+  if(!Tiny::event.keys.empty()){
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_p){
+      simulation.paused = !simulation.paused;
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_ESCAPE){
+      viewmap = !viewmap;
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_t){
+      simulation.post([](){
+        world.tiled = !world.tiled;
+        std::cout<<"Tiled Erosion: "<<((world.tiled)?"On":"Off")<<std::endl;
+      });
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_v){
+      simulation.post([](){
+        world.packed = !world.packed;
+        std::cout<<"Packet Erosion: "<<((world.packed)?"On":"Off")<<std::endl;
+      });
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_b){
+      simulation.post([](){
+        world.basins = !world.basins;
+        std::cout<<"Lake Registry: "<<((world.basins)?"On":"Off")<<std::endl;
+      });
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_f){
+      simulation.post([](){
+        world.spillmap = !world.spillmap;
+        std::cout<<"Depression Map: "<<((world.spillmap)?"On":"Off")<<std::endl;
+      });
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_g){
+      const char* names[3] = {"Quad Mesh", "Packed Grid", "GPU Displacement"};
+      meshing = (Meshing)((meshing+1)%3);
+      std::cout<<"Terrain: "<<names[meshing]<<std::endl;
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_SPACE){
+      viewPos += glm::vec3(0.0, 1.0, 0.0);
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_c){
+      viewPos -= glm::vec3(0.0, 1.0, 0.0);
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_w){
+      viewPos -= glm::vec3(1.0, 0.0, 0.0);
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_a){
+      viewPos += glm::vec3(0.0, 0.0, 1.0);
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_s){
+      viewPos += glm::vec3(1.0, 0.0, 0.0);
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_d){
+      viewPos -= glm::vec3(0.0, 0.0, 1.0);
+    }
+
+	if (Tiny::event.keys.back().key.keysym.sym == SDLK_r) {
+		simulation.post([]() {
+			world.SEED = 0;
+			world.generate();
+		}, true);
+	}
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_UP){
+      cameraPos += glm::vec3(0, 5, 0);
+      camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
+    }
+
+    if(Tiny::event.keys.back().key.keysym.sym == SDLK_DOWN){
+      cameraPos -= glm::vec3(0, 5, 0);
+      camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
+    }
+
+	if (Tiny::event.keys.back().key.keysym.sym == SDLK_LEFT) {
+		rotation += 4.5f;
+		camera = glm::rotate(camera, glm::radians(1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	if (Tiny::event.keys.back().key.keysym.sym == SDLK_RIGHT) {
+		rotation -= 4.5f;
+		camera = glm::rotate(camera, glm::radians(-1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	//Adjust Stuff
+	if (rotation < 0.0) rotation = 360.0 + rotation;
+	else if (rotation > 360.0) rotation = rotation - 360.0;
+	camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0, 1, 0)), glm::radians(rotation), glm::vec3(0, 1, 0));
+
+    //Remove the guy
+    Tiny::event.keys.pop_back();
+  }
+};
+
+std::function<glm::vec4(scalar, scalar)> hydromap = [](scalar t1, scalar t2){
+  glm::vec4 color = glm::mix(glm::vec4(0.0, 0.0, 0.0, 1.0), glm::vec4(0.2, 0.5, 1.0, 1.0), t1);
+  if(t2 > 0.0) color = glm::mix(color, glm::vec4(0.15, 0.15, 0.45, 1.0), 1.0 - ease::langmuir(t2, 5.0));
+  return color;
+};
@@ -0,0 +1,62 @@
+#version 130
+
+//Map Fields, one Texel per Cell (s: Column, t: Row)
+uniform sampler2D heightmap;
+uniform sampler2D waterpool;
+uniform sampler2D waterpath;
+uniform float scale;
+
+//Patch of a Chunk (see chunks.h)
+uniform vec2 origin;      //First Cell
+uniform int step;         //Cells per Vertex
+uniform int cols;         //Patch Vertices per Side, with the Skirt Ring
+uniform float skirt;      //Depth of the Skirt below the Edge
+
+//Color Stuff
+uniform vec3 flatColor;
+uniform vec3 waterColor;
+
+//Uniforms
+uniform mat4 model;
+uniform mat4 projectionCamera;
+uniform mat4 dbmvp;
+
+//Same Outputs as terrain.vs
+out vec4 ex_Color;
+out vec3 ex_Normal;
+out vec4 ex_Shadow;
+out vec3 ex_FragPos;
+
+//Water Surface at a Cell, clamped to the Map
+float surface(ivec2 p){
+	ivec2 size = textureSize(heightmap, 0);
+	ivec2 t = clamp(p.yx, ivec2(0), size - 1);
+	return scale*(texelFetch(heightmap, t, 0).r + texelFetch(waterpool, t, 0).r);
+}
+
+void main(void) {
+	ivec2 size = textureSize(heightmap, 0).yx;
+
+	//Cell of the Vertex, the Skirt Ring repeats the Patch Edge
+	ivec2 q = ivec2(gl_VertexID / cols, gl_VertexID % cols);
+	ivec2 p = min(ivec2(origin) + step*clamp(q - 1, ivec2(0), ivec2(cols - 3)), size - 1);
+	bool edge = any(equal(q, ivec2(0))) || any(equal(q, ivec2(cols - 1)));
+
+	//Central Differences over the Vertex Spacing, One-Sided at the Edge
+	ivec2 lo = max(p - step, ivec2(0));
+	ivec2 hi = min(p + step, size - 1);
+	float dx = (surface(ivec2(hi.x, p.y)) - surface(ivec2(lo.x, p.y))) / float(hi.x - lo.x);
+	float dz = (surface(ivec2(p.x, hi.y)) - surface(ivec2(p.x, lo.y))) / float(hi.y - lo.y);
+	ex_Normal = normalize(vec3(-dx, 1.0, -dz));
+
+	//Color of the Ground (Water vs. Flat), Alpha flags Water
+	float pool = texelFetch(waterpool, p.yx, 0).r;
+	float path = texelFetch(waterpath, p.yx, 0).r;
+	if(pool > 0.0) ex_Color = vec4(waterColor, 1.0);
+	else ex_Color = vec4(mix(flatColor, waterColor, path), 0.0);
+
+	vec3 inPos = vec3(p.x, surface(p) - (edge ? skirt : 0.0), p.y);
+	ex_FragPos = (model * vec4(inPos, 1.0f)).xyz;
+	ex_Shadow = dbmvp * vec4(ex_FragPos, 1.0f);
+	gl_Position = projectionCamera * vec4(ex_FragPos, 1.0f);
+}
@@ -0,0 +1,22 @@
+#version 130
+
+uniform sampler2D heightmap;
+uniform sampler2D waterpool;
+uniform float scale;
+uniform mat4 dmvp;
+
+//Patch of a Chunk, as in displace.vs
+uniform vec2 origin;
+uniform int step;
+uniform int cols;
+uniform float skirt;
+
+void main(void) {
+	ivec2 size = textureSize(heightmap, 0).yx;
+	ivec2 q = ivec2(gl_VertexID / cols, gl_VertexID % cols);
+	ivec2 p = min(ivec2(origin) + step*clamp(q - 1, ivec2(0), ivec2(cols - 3)), size - 1);
+	bool edge = any(equal(q, ivec2(0))) || any(equal(q, ivec2(cols - 1)));
+
+	float height = scale*(texelFetch(heightmap, p.yx, 0).r + texelFetch(waterpool, p.yx, 0).r);
+	gl_Position = dmvp * vec4(p.x, height - (edge ? skirt : 0.0), p.y, 1.0f);
+}
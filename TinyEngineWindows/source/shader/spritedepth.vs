@@ -1,13 +1,16 @@
 #version 130
 in vec3 in_Quad;
 in vec2 in_Tex;
-in mat4 in_Model;
+in vec4 in_Instance;        //Top of the Trunk (xyz) and Size (w)
 
 uniform mat4 projectionCamera;
+uniform mat4 model;
+uniform float facing;       //Turn about the Vertical (Radians)
 
 out vec2 ex_Tex;
 
 void main(){
   ex_Tex = in_Tex;
-  gl_Position = projectionCamera*in_Model*vec4(in_Quad, 1.0);
+  vec3 quad = in_Instance.w*vec3(cos(facing)*in_Quad.x, in_Quad.y, -sin(facing)*in_Quad.x);
+  gl_Position = projectionCamera*model*vec4(in_Instance.xyz + quad, 1.0);
 }
@@ -0,0 +1,68 @@
+#version 130
+//Lighting Settings
+uniform vec3 lightCol;
+uniform vec3 lightPos;
+uniform vec3 lookDir;
+uniform float lightStrength;
+
+//Color Stuff
+uniform vec3 steepColor;
+uniform float steepness;
+
+//Sampler for the ShadowMap
+uniform sampler2D shadowMap;
+
+//IO
+in vec4 ex_Color;
+in vec3 ex_Normal;
+in vec4 ex_Shadow;
+in vec3 ex_FragPos;
+out vec4 fragColor;
+
+//Sample a grid..
+float gridSample(int size){
+  float shadow = 0.0;
+  float currentDepth = ex_Shadow.z;
+
+  for(int x = -size; x <= size; ++x){
+      for(int y = -size; y <= size; ++y){
+          float pcfDepth = texture(shadowMap, ex_Shadow.xy + vec2(x, y) / textureSize(shadowMap, 0)).r;
+          shadow += currentDepth - 0.001 > pcfDepth ? 1.0 : 0.0;
+      }
+  }
+  //Normalize
+  shadow/=12.0;
+  return shadow;
+}
+
+vec4 shade(){
+    float shadow = 0.0;
+    if(greaterThanEqual(ex_Shadow.xy, vec2(0.0f)) == bvec2(true) && lessThanEqual(ex_Shadow.xy, vec2(1.0f)) == bvec2(true))
+      shadow = gridSample(1);
+    return vec4(vec3(1.0-shadow), 1.0f);
+}
+
+//Same Terms as the Quad Mesh (default.vs), per Fragment
+vec4 gouraud(vec3 normal){
+	float diffuse = clamp(dot(normal, normalize(lightPos)), 0.1, 0.9);
+	float ambient = 0.1;
+	float spec = 0.8*pow(max(dot(normalize(lookDir), normalize(reflect(lightPos, normal))), 0.0), 32.0);
+
+	return vec4(lightCol*lightStrength*(diffuse + ambient + spec), 1.0f);
+}
+
+void main(void) {
+  //Water on all Corners: Flat Face Normal
+  bool water = (ex_Color.a > 0.99);
+  vec3 normal = normalize(ex_Normal);
+  if(water){
+    normal = normalize(cross(dFdx(ex_FragPos), dFdy(ex_FragPos)));
+    if(normal.y < 0.0) normal = -normal;
+  }
+
+  vec3 color = ex_Color.rgb;
+  if(!water && normal.y < steepness)
+    color = steepColor;
+
+  fragColor = shade()*gouraud(normal)*vec4(color, 1.0f);
+}
@@ -0,0 +1,35 @@
+#version 130
+in float in_Height;
+in vec2 in_Normal;
+in vec4 in_Color;
+
+//Grid Size
+uniform int cols;
+
+//Uniforms
+uniform mat4 model;
+uniform mat4 projectionCamera;
+uniform mat4 dbmvp;
+
+out vec4 ex_Color;
+out vec3 ex_Normal;
+out vec4 ex_Shadow;
+out vec3 ex_FragPos;
+
+//Octahedral Normal (Y is up)
+vec3 octahedral(vec2 e){
+	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+	if(n.y < 0.0)
+		n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main(void) {
+	//Position from the Vertex Index (Row Major)
+	vec3 inPos = vec3(gl_VertexID / cols, in_Height, gl_VertexID % cols);
+	ex_FragPos = (model * vec4(inPos, 1.0f)).xyz;
+	ex_Shadow = dbmvp * vec4(ex_FragPos, 1.0f);
+	gl_Position = projectionCamera * vec4(ex_FragPos, 1.0f);
+	ex_Normal = octahedral(in_Normal);
+	ex_Color = in_Color;
+}
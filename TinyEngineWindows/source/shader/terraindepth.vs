@@ -0,0 +1,11 @@
+#version 130
+
+in float in_Height;
+uniform int cols;
+uniform mat4 dmvp;
+
+void main(void) {
+	//Position from the Vertex Index, as in terrain.vs
+	vec3 inPos = vec3(gl_VertexID / cols, in_Height, gl_VertexID % cols);
+	gl_Position = dmvp * vec4(inPos, 1.0f);
+}
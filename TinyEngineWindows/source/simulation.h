@@ -0,0 +1,240 @@
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+/*
+  Everything the renderer reads from a world: heights, pools, the baked water
+  path and the trees. The mesher and image::make take it like a World.
+
+  dirty holds the spans of cells that differ from the snapshot before it on
+  screen (see Spans in field.h), so the mesh only rebuilds those: the cells
+  the world wrote since, and the cells of the path band (see Simulation)
+  whose 8-bit shade changed.
+*/
+
+template<typename T>
+struct Snapshot{
+  glm::ivec2 dim = glm::ivec2(0);
+  T scale = 0.0;
+  Field<T> heightmap;
+  Field<T> waterpool;
+  Field<T> waterpath;
+  Plants trees;
+
+  Spans dirty;                          //Changed Cell Columns per Row (see field.h)
+  bool full = true;                     //Size changed: rebuild everything
+};
+
+/*
+  Simulation Thread: erodes and grows the world on a worker, as fast as it
+  can, while the render loop draws at its own rate. After each frame the
+  worker brings the back buffer of a snapshot pair up to date and compares
+  it against the front one. The render thread swaps buffers in poll() and
+  builds from the front one, which the worker never writes. poll() does not
+  wait for a publish in progress. Pausing only stops the worker.
+
+  A publish only copies the cells the world wrote since the last one (see
+  World::changed), plus the cells the last one wrote into the other buffer,
+  from there. Paths decay everywhere, so one band of rows is baked and
+  copied whole per publish, and a row shows the decay every BANDS frames.
+  While the front has not taken the back, publish waits and the world keeps
+  collecting its changes.
+
+  Only the worker writes the world. Anything else that changes it (toggles,
+  regenerating) posts a command, which the worker runs between two steps,
+  also while paused, and publishes after if the view should follow. So the
+  render thread never waits for a step. The worker holds mutex only while it
+  writes the world, for code that has to read it in place.
+*/
+
+template<typename T>
+class Simulation{
+public:
+  Simulation(World<T>& w):world(w){}
+  ~Simulation(){ stop(); }
+
+  void start();                         //Publish the World, then launch the Worker
+  void stop();
+  void publish();                       //Copy the World into the Back Buffer (Worker, or before start)
+  Snapshot<T>* poll();                  //Render Thread: Newer Snapshot or NULL
+  Snapshot<T>& current(){ return buffer[front]; }
+
+  //Change the World on the Worker before its next Step
+  void post(std::function<void()> command, bool show = false);
+
+  std::mutex mutex;                     //Held while the World is written
+  std::atomic<bool> paused{true};
+  int drops = 256;                      //Drops per Frame
+
+private:
+  World<T>& world;
+  Snapshot<T> buffer[2];
+  int front = 0;
+  bool fresh = false;                   //Back Buffer is newer than the Front
+  bool pending = false;                 //A Publish waited for the Front (Worker only)
+  Spans copied;                         //Cells the last Publish took from the World
+  int band = 0;                         //Next Band of Rows with decayed Paths
+  static const int BANDS = 16;
+  std::mutex exchange;                  //Guards the Back Buffer and fresh
+
+  struct Command{
+    std::function<void()> run;
+    bool show;                          //Publish after it ran
+  };
+  std::vector<Command> commands;
+  std::mutex queue;                     //Guards commands
+
+  std::thread worker;
+  std::atomic<bool> quit{false};
+  void run();
+  void drain();                         //Run the posted Commands
+
+  static int shade(T p){ return (int)(p*T(255)); }
+};
+
+template<typename T>
+void Simulation<T>::start(){
+  publish();
+  poll();
+  quit = false;
+  worker = std::thread([this](){ run(); });
+}
+
+template<typename T>
+void Simulation<T>::stop(){
+  quit = true;
+  if(worker.joinable())
+    worker.join();
+}
+
+template<typename T>
+void Simulation<T>::post(std::function<void()> command, bool show){
+  std::lock_guard<std::mutex> lock(queue);
+  commands.push_back({command, show});
+}
+
+template<typename T>
+void Simulation<T>::drain(){
+  std::vector<Command> posted;
+  {
+    std::lock_guard<std::mutex> lock(queue);
+    posted.swap(commands);
+  }
+  if(posted.empty()) return;
+
+  bool show = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& c: posted){
+      c.run();
+      show = show || c.show;
+    }
+  }
+  if(show) publish();
+}
+
+template<typename T>
+void Simulation<T>::run(){
+  while(!quit){
+    drain();
+    if(paused){
+      if(pending) publish();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      world.erode(drops);
+      world.grow();
+    }
+    publish();
+  }
+}
+
+template<typename T>
+void Simulation<T>::publish(){
+  std::lock_guard<std::mutex> lock(exchange);
+  if(fresh){
+    pending = true;
+    return;
+  }
+  pending = false;
+
+  Snapshot<T>& back = buffer[1-front];
+  Snapshot<T>& shown = buffer[front];
+  const glm::ivec2 dim = world.dim;
+  Field<T>& h = world.heightmap;
+  Field<T>& p = world.waterpool;
+  Spans& fetch = world.changed;
+  if(fetch.count != dim.x || fetch.height != dim.y) fetch.resize(dim);
+
+  //Written Cells changed against the Front (the Mesh on Screen)
+  back.full = (shown.dim != dim);
+  back.dirty = fetch;
+
+  //Cells from the World: written since the last Publish, and the next Band
+  const int lower = band*dim.x/BANDS, upper = (band+1)*dim.x/BANDS;
+  band = (band+1)%BANDS;
+  for(int x = lower; x < upper; x++)
+    fetch.mark(x, fetch.full());
+
+  //New Size: everything from the World
+  if(back.dim != dim || back.full){
+    fetch.all();
+    back.dirty.all();
+    back.heightmap = h;
+    back.waterpool = p;
+    back.waterpath = world.waterpath.bake();
+  }
+
+  else{
+    //Cells the last Publish wrote into the Front only
+    for(int x = 0; x < dim.x; x++)
+    for(int s = 0; s < copied.segments; s++){
+      const glm::ivec2 span = copied.row(x)[s];
+      if(span.x > span.y) continue;
+      const int i = h.index(glm::ivec2(x, span.x));
+      const size_t n = (span.y - span.x + 1)*sizeof(T);
+      memcpy(&back.heightmap[i], &shown.heightmap[i], n);
+      memcpy(&back.waterpool[i], &shown.waterpool[i], n);
+      memcpy(&back.waterpath[i], &shown.waterpath[i], n);
+    }
+
+    for(int x = 0; x < dim.x; x++)
+    for(int s = 0; s < fetch.segments; s++){
+      const glm::ivec2 span = fetch.row(x)[s];
+      if(span.x > span.y) continue;
+      const int i = h.index(glm::ivec2(x, span.x));
+      const int n = span.y - span.x + 1;
+      memcpy(&back.heightmap[i], &h[i], n*sizeof(T));
+      memcpy(&back.waterpool[i], &p[i], n*sizeof(T));
+      memcpy(&back.waterpath[i], world.waterpath.bake(i, n), n*sizeof(T));
+    }
+  }
+
+  //Cells of the Band where the Shade of the Path changed
+  auto faded = [&](int i){ return shade(back.waterpath[i]) != shade(shown.waterpath[i]); };
+  for(int x = lower; x < upper && !back.full; x++){
+    const int row = h.index(glm::ivec2(x, 0));
+    for(int y = 0; y < dim.y; y++)
+      if(faded(row+y)) back.dirty.mark(glm::ivec2(x, y));
+  }
+
+  back.dim = dim;
+  back.scale = world.scale;
+  back.trees = world.trees;
+  copied = fetch;
+  fetch.clear();
+  fresh = true;
+}
+
+template<typename T>
+Snapshot<T>* Simulation<T>::poll(){
+  std::unique_lock<std::mutex> lock(exchange, std::try_to_lock);
+  if(!lock.owns_lock() || !fresh) return NULL;
+  front = 1-front;
+  fresh = false;
+  return &buffer[front];
+}
@@ -0,0 +1,113 @@
+#include <chrono>
+#include <ostream>
+
+/*
+  Erosion Counters of one erode call. Drops and the world count through a
+  pointer that is NULL while counting is off, so a disabled counter costs one
+  predictable branch. Phase times are wall time of the serial paths; tiles
+  count into their own copy, so their descend and flood times are summed over
+  all threads.
+*/
+
+struct Stats{
+
+  enum Phase{ MAPS, DESCEND, FLOOD, PATH, TOTAL, PHASES };
+
+  long spawned = 0;             //Drops spawned
+  long steps = 0;               //Descend Steps
+  long outofbounds = 0;         //Drops that left the Map
+  long poolentries = 0;         //Descends that stopped on a Pool
+  long floods = 0;              //Flood Calls
+  long flooditerations = 0;     //Fill Rounds of all Floods
+  long drains = 0;              //Floods that found a Drain or Outlet
+  long exhausted = 0;           //Floods that ran out of Tries (fail == 0)
+  long touched = 0;             //Distinct Cells on Drop Paths
+  double time[PHASES] = {0.0};  //Seconds per Phase
+
+  Stats& operator+=(const Stats& o){
+    spawned += o.spawned;
+    steps += o.steps;
+    outofbounds += o.outofbounds;
+    poolentries += o.poolentries;
+    floods += o.floods;
+    flooditerations += o.flooditerations;
+    drains += o.drains;
+    exhausted += o.exhausted;
+    touched += o.touched;
+    for(int i = 0; i < PHASES; i++)
+      time[i] += o.time[i];
+    return *this;
+  }
+
+  double stepsPerDrop() const {
+    return (spawned > 0)?(double)steps/spawned:0.0;
+  }
+
+  //Adds the Time of a Scope to a Phase (Nothing when the Stats are NULL)
+  struct Timer{
+    Stats* s;
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+    Timer(Stats* _s, Phase _p):s(_s),phase(_p){
+      if(s) start = std::chrono::steady_clock::now();
+    }
+    ~Timer(){
+      if(s) s->time[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+  };
+
+  struct Log;                   //Writes Calls as they finish
+};
+
+/*
+  Writes the counters of every erode call as it finishes, one CSV line or one
+  element of a JSON array, so a run of any length keeps no list of its calls.
+  close() ends the array.
+*/
+
+struct Stats::Log{
+  std::ostream& out;
+  bool json;
+  long calls = 0;
+
+  Log(std::ostream& _out, bool _json);
+  void write(const Stats& s);
+  void close();
+};
+
+Stats::Log::Log(std::ostream& _out, bool _json):out(_out),json(_json){
+  if(json) out<<"[\n";
+  else out<<"call,spawned,steps,steps_per_drop,out_of_bounds,pool_entries,floods,flood_iterations,drains,exhausted,cells_touched,maps_s,descend_s,flood_s,path_s,total_s\n";
+}
+
+void Stats::Log::write(const Stats& s){
+
+  if(!json){
+    out<<calls<<","<<s.spawned<<","<<s.steps<<","<<s.stepsPerDrop()<<","<<s.outofbounds<<","
+       <<s.poolentries<<","<<s.floods<<","<<s.flooditerations<<","<<s.drains<<","
+       <<s.exhausted<<","<<s.touched;
+    for(int i = 0; i < PHASES; i++)
+      out<<","<<s.time[i];
+    out<<"\n";
+  }
+
+  else{
+    const char* phases[PHASES] = {"maps", "descend", "flood", "path", "total"};
+    out<<((calls > 0)?",\n":"")
+       <<"  {\"call\": "<<calls<<", \"spawned\": "<<s.spawned<<", \"steps\": "<<s.steps
+       <<", \"steps_per_drop\": "<<s.stepsPerDrop()<<", \"out_of_bounds\": "<<s.outofbounds
+       <<", \"pool_entries\": "<<s.poolentries<<", \"floods\": "<<s.floods
+       <<", \"flood_iterations\": "<<s.flooditerations<<", \"drains\": "<<s.drains
+       <<", \"exhausted\": "<<s.exhausted<<", \"cells_touched\": "<<s.touched<<", \"seconds\": {";
+    for(int i = 0; i < PHASES; i++)
+      out<<((i > 0)?", ":"")<<"\""<<phases[i]<<"\": "<<s.time[i];
+    out<<"}}";
+  }
+
+  calls++;
+}
+
+void Stats::Log::close(){
+  if(json) out<<((calls > 0)?"\n":"")<<"]\n";
+  out.flush();
+}
@@ -1,68 +1,241 @@
 struct Plant{
-  Plant(int i, glm::ivec2 d){
+  template<typename T>
+  Plant(int i, Field<T>& f){
     index = i;
-    pos = glm::vec2(i/d.y, i%d.y);
+    pos = f.pos(i);
   };
 
-  Plant(glm::vec2 p, glm::ivec2 d){
+  template<typename T>
+  Plant(glm::vec2 p, Field<T>& f){
     pos = p;
-    index = (int)p.x*d.y+(int)p.y;
+    index = f.index(p);
   };
 
+  Plant(glm::vec2 p, int i, float s):pos(p),index(i),size(s){};
+
   glm::vec2 pos;
   int index;
   float size = 0.5;
-  const float maxsize = 1.0;
-  const float rate = 0.05;
-
-  void grow();
-  void root(double* density, glm::ivec2 dim, double factor);
+  static constexpr float maxsize = 1.0;
+  static constexpr float rate = 0.05;
+};
 
-  Plant& operator=(const Plant& o){
-    if(this != &o){  //Self Check
-      pos = o.pos;
-      index = o.index;
-      size = o.size;
-    }
-    return *this;
-  };
+/*
+  Plants: the trees of a world as a structure of arrays, one per member, so
+  the growth pass runs over a plain float array. Every tree gets a handle at
+  birth and keeps it while it lives. Trees are born at the end of the list
+  and World::grow compacts the dead out in order, so handles rise along the
+  list. Renderers pair trees across snapshots by handle (see Forest).
+*/
+
+struct Plants{
+  std::vector<glm::vec2> pos;
+  std::vector<int> index;
+  std::vector<float> size;
+  std::vector<unsigned int> id;         //Stable Handle
+  unsigned int serial = 0;              //Handle of the next Birth
+
+  size_t count() const { return index.size(); }
+  bool empty() const { return index.empty(); }
+  size_t bytes() const { return count()*(sizeof(glm::vec2)+sizeof(int)+sizeof(float)+sizeof(unsigned int)); }
+  Plant operator[](size_t i) const { return Plant(pos[i], index[i], size[i]); }
+
+  void clear();
+  void push(const Plant& plant);        //Birth, with a new Handle
+  void move(size_t from, size_t to);    //Overwrite a Tree
+  void resize(size_t n);                //Keep the first n Trees
+  void grow();                          //Grow every Tree
 };
 
+void Plants::clear(){
+  resize(0);                            //Handles stay unique
+}
 
-void Plant::grow(){
-  size += rate*(maxsize-size);
-};
+void Plants::push(const Plant& plant){
+  pos.push_back(plant.pos);
+  index.push_back(plant.index);
+  size.push_back(plant.size);
+  id.push_back(serial++);
+}
 
-void Plant::root(double* density, glm::ivec2 dim, double f){
+void Plants::move(size_t from, size_t to){
+  if(from == to) return;
+  pos[to] = pos[from];
+  index[to] = index[from];
+  size[to] = size[from];
+  id[to] = id[from];
+}
 
-  //Can always do this one
-  density[index]       += f*1.0;
+void Plants::resize(size_t n){
+  pos.resize(n, glm::vec2(0));
+  index.resize(n, 0);
+  size.resize(n, 0.0f);
+  id.resize(n, 0);
+}
 
-  if(pos.x > 0){
-    //
-    density[index - 256] += f*0.6;      //(-1, 0)
+void Plants::grow(){
+  float* s = size.data();
+  const size_t n = size.size();
+  for(size_t i = 0; i < n; i++)
+    s[i] += Plant::rate*(Plant::maxsize-s[i]);
+}
 
-    if(pos.y > 0)
-      density[index - 257] += f*0.4;    //(-1, -1)
+/*
+  Root Density: the plant density is the number of trees per cell, convolved
+  with the kernel g(dx)g(dy) + h(dx)h(dy), g(d) = 1 - 0.4|d|/radius and
+  h(d) = 0.2|d|/radius for |d| up to the radius. At radius 1 this is the
+  original stencil: 1 on the tree, 0.6 beside it and 0.36 + 0.04 = 0.4
+  diagonally, which no single separable kernel gives. h only adds weight
+  off the axes, so it is a second separable pass next to g.
+
+  A birth or death only counts the tree in its cell and widens the span of
+  changed cells of its row (x > y: none). apply() brings the density up to
+  date once per tick, in two passes of plain loops over contiguous cells,
+  which the compiler vectorizes: the changed spans are convolved along their
+  rows (by g and by h), then the density rows within the radius are summed
+  across the convolved rows, each over the spans it reaches. at() sums the density of a
+  single cell from the counts in the same order, so trees born later in a
+  tick already see the ones born before them.
+*/
+
+template<typename T>
+class Roots{
+public:
+  void resize(glm::ivec2 dim, Scratch* scratch = NULL);
+  void reach(int radius);               //New Kernel, everything changed
+
+  void add(int index, T trees);         //Births (+) or Deaths (-) in a Cell
+  T at(int index) const;                //Density of one Cell, up to Date
+  void apply(Field<T>& density);        //Density around the changed Rows
+  void rebuild(const Plants& trees, Field<T>& density);  //Count all Trees again
+  size_t bytes() const { return count.bytes() + rows.bytes() + diagonals.bytes(); }
+
+  int radius = 1;
+  std::vector<T> weights = {0.6, 1.0, 0.6};   //g(-radius) to g(radius)
+  std::vector<T> corners = {0.2, 0.0, 0.2};   //h(-radius) to h(radius)
+
+private:
+  glm::ivec2 dim = glm::ivec2(0);
+  Field<T> count;                       //Trees per Cell
+  Field<T> rows;                        //Count convolved along each Row by g
+  Field<T> diagonals;                   //Count convolved along each Row by h
+  std::vector<glm::ivec2> changed;      //Span of count per Row since apply
+  std::vector<glm::ivec2> reached;      //Span of Density per Row to sum again
+
+  glm::ivec2 none() const { return glm::ivec2(dim.y, -1); }
+  glm::ivec2 all() const { return glm::ivec2(0, dim.y-1); }
+};
 
-    if(pos.y < 256-1)
-      density[index - 255] += f*0.4;    //(-1, 1)
+template<typename T>
+void Roots<T>::resize(glm::ivec2 size, Scratch* scratch){
+  dim = size;
+  Scratch::resize(count, dim, scratch);
+  Scratch::resize(rows, dim, scratch);
+  Scratch::resize(diagonals, dim, scratch);
+  changed.assign(dim.x, none());        //Zero Counts, zero Density
+  reached.assign(dim.x, none());
+}
+
+template<typename T>
+void Roots<T>::reach(int r){
+  radius = std::max(r, 0);
+  weights.resize(2*radius+1);
+  corners.resize(2*radius+1);
+  for(int d = -radius; d <= radius; d++){
+    weights[d+radius] = (radius == 0) ? 1.0 : 1.0 - 0.4*std::abs(d)/radius;
+    corners[d+radius] = (radius == 0) ? 0.0 : 0.2*std::abs(d)/radius;
   }
+  std::fill(changed.begin(), changed.end(), all());
+}
 
-  if(pos.x < 256-1){
-    //
-    density[index + 256] += f*0.6;    //(1, 0)
+template<typename T>
+void Roots<T>::add(int index, T trees){
+  count[index] += trees;
+  const glm::ivec2 p = count.pos(index);
+  glm::ivec2& span = changed[p.x];
+  span = glm::ivec2(std::min(span.x, p.y), std::max(span.y, p.y));
+}
 
-    if(pos.y > 0)
-      density[index + 255] += f*0.4;    //(1, -1)
+template<typename T>
+T Roots<T>::at(int index) const {
+  const glm::ivec2 p = count.pos(index);
+  const int lower = std::max(-radius, -p.y);
+  const int upper = std::min(radius, dim.y-1-p.y);
+
+  T density = 0.0;
+  for(int dx = -radius; dx <= radius; dx++){
+    if(p.x+dx < 0 || p.x+dx >= dim.x) continue;
+    const T* row = &count[index + dx*count.stride];
+    T sum = 0.0, diagonal = 0.0;
+    for(int dy = lower; dy <= upper; dy++){
+      sum += weights[dy+radius]*row[dy];
+      diagonal += corners[dy+radius]*row[dy];
+    }
+    density += weights[dx+radius]*sum + corners[dx+radius]*diagonal;
+  }
+  return density;
+}
 
-    if(pos.y < 256-1)
-      density[index + 257] += f*0.4;    //(1, 1)
+template<typename T>
+void Roots<T>::apply(Field<T>& density){
+
+  const int s = count.stride;
+
+  //Convolve the changed Spans along their Rows
+  for(int x = 0; x < dim.x; x++){
+    const glm::ivec2 span = changed[x];
+    if(span.x > span.y) continue;
+    changed[x] = none();
+
+    const int lower = std::max(span.x-radius, 0);
+    const int upper = std::min(span.y+radius, dim.y-1);
+    for(int X = std::max(x-radius, 0); X <= std::min(x+radius, dim.x-1); X++)
+      reached[X] = glm::ivec2(std::min(reached[X].x, lower), std::max(reached[X].y, upper));
+
+    const T* in = &count[x*s];
+    T* out = &rows[x*s];
+    T* corner = &diagonals[x*s];
+    std::fill(out+lower, out+upper+1, T(0));
+    std::fill(corner+lower, corner+upper+1, T(0));
+    for(int d = -radius; d <= radius; d++){
+      const T w = weights[d+radius], c = corners[d+radius];
+      const int a = std::max(lower, -d);
+      const int b = std::min(upper, dim.y-1-d);
+      for(int y = a; y <= b; y++)
+        out[y] += w*in[y+d];
+      if(c != 0.0)
+        for(int y = a; y <= b; y++)
+          corner[y] += c*in[y+d];
+    }
   }
 
-  if(pos.y > 0)
-    density[index - 1]   += f*0.6;    //(0, -1)
+  //Sum the reached Spans across the convolved Rows
+  for(int x = 0; x < dim.x; x++){
+    const glm::ivec2 span = reached[x];
+    if(span.x > span.y) continue;
+    reached[x] = none();
+
+    T* out = &density[x*s];
+    std::fill(out+span.x, out+span.y+1, T(0));
+    for(int d = -radius; d <= radius; d++){
+      if(x+d < 0 || x+d >= dim.x) continue;
+      const T w = weights[d+radius], c = corners[d+radius];
+      const T* in = &rows[(x+d)*s];
+      for(int y = span.x; y <= span.y; y++)
+        out[y] += w*in[y];
+      if(c == 0.0) continue;
+      const T* corner = &diagonals[(x+d)*s];
+      for(int y = span.x; y <= span.y; y++)
+        out[y] += c*corner[y];
+    }
+  }
+}
 
-  if(pos.y < 256-1)
-    density[index + 1]   += f*0.6;    //(0, 1)
+template<typename T>
+void Roots<T>::rebuild(const Plants& trees, Field<T>& density){
+  count.clear();
+  for(size_t i = 0; i < trees.count(); i++)
+    count[trees.index[i]] += 1.0;
+  std::fill(changed.begin(), changed.end(), all());
+  apply(density);
 }
@@ -1,10 +1,17 @@
 #include <vector>
+#include "archive.h"
+#include "path.h"
+#include "stats.h"
+#include "lakes.h"
+#include "depressions.h"
+
+template<typename T>
 struct Drop{
   //Construct Particle at Position
   Drop(glm::vec2 _pos){ pos = _pos; }
-  Drop(glm::vec2 _p, glm::ivec2 dim, double v){
+  Drop(glm::vec2 _p, Field<T>& h, T v){
     pos = _p;
-    int index = _p.x*dim.y+_p.y;
+    index = h.index(_p);
     volume = v;
   }
 
@@ -12,137 +19,278 @@ struct Drop{
   int index;
   glm::vec2 pos;
   glm::vec2 speed = glm::vec2(0.0);
-  double volume = 1.0;   //This will vary in time
-  double sediment = 0.0; //Sediment concentration
+  T volume = 1.0;        //This will vary in time
+  T sediment = 0.0;      //Sediment concentration
 
   //Parameters
   const float dt = 1.2;
-  const double density = 1.0;  //This gives varying amounts of inertia and stuff...
-  const double evapRate = 0.001;
-  const double depositionRate = 0.08;
-  const double minVol = 0.01;
-  const double friction = 0.1;
-  const double volumeFactor = 100.0; //"Water Deposition Rate"
+  const T density = 1.0;  //This gives varying amounts of inertia and stuff...
+  const T evapRate = 0.001;
+  const T depositionRate = 0.08;
+  const T minVol = 0.01;
+  const T friction = 0.1;
+  const T volumeFactor = 100.0; //"Water Deposition Rate"
+
+  //Lifetime State (Resumable)
+  int spill = 5;                //Remaining Descend / Flood Rounds
+  bool flooding = false;        //Next Round starts with Flood
+
+  //Confinement (Tile-Parallel Erosion)
+  bool confined = false;
+  bool parked = false;          //Drop left its Region and awaits the serial Pass
+  glm::ivec2 lower, upper;      //Region it may read and write in [lower, upper)
+  bool inside(glm::ivec2 p){
+    return glm::all(glm::greaterThanEqual(p, lower)) && glm::all(glm::lessThan(p, upper));
+  }
+
+  //Out-of-Core Fields (see archive.h)
+  Scratch* scratch = NULL;      //Page in the Block ahead when set
+
+  //Changed Cells (see field.h)
+  Spans* spans = NULL;          //Records the Cells written when set
 
   //Sedimenation Process
-  void descend(double* h, double* path, double* pool, bool* track, double* pd, glm::ivec2 dim, double scale);
-  void flood(double* h, double* pool, glm::ivec2 dim);
+  void descend(Field<T>& h, Field<glm::vec3>& normals, Path<T>& path, Field<T>& pool, std::vector<int>& track, Field<T>& pd, T scale, Lakes<T>* lakes = NULL, Depressions<T>* spills = NULL, Stats* stats = NULL);
+  void flood(Field<T>& h, Field<T>& pool, Lakes<T>* lakes = NULL, Depressions<T>* spills = NULL, Stats* stats = NULL);
+  void route(Field<T>& h, Field<T>& pool, Depressions<T>& spills, Lakes<T>* lakes = NULL, Stats* stats = NULL);
 };
 
-glm::vec3 surfaceNormal(int index, double* h, glm::ivec2 dim, double scale){
+template<typename T>
+glm::vec3 surfaceNormal(int index, Field<T>& h, T scale){
+
+  const int s = h.stride;
 
   //Two large triangels adjacent to the plane (+Y -> +X) (-Y -> -X)
-  glm::vec3 n = glm::cross(glm::vec3(0.0, scale*(h[index+1]-h[index]), 1.0), glm::vec3(1.0, scale*(h[index+dim.y]-h[index]), 0.0));
-  n += glm::cross(glm::vec3(0.0, scale*(h[index-1]-h[index]), -1.0), glm::vec3(-1.0, scale*(h[index-dim.y]-h[index]), 0.0));
+  glm::vec3 n = glm::cross(glm::vec3(0.0, scale*(h[index+1]-h[index]), 1.0), glm::vec3(1.0, scale*(h[index+s]-h[index]), 0.0));
+  n += glm::cross(glm::vec3(0.0, scale*(h[index-1]-h[index]), -1.0), glm::vec3(-1.0, scale*(h[index-s]-h[index]), 0.0));
 
   //Two Alternative Planes (+X -> -Y) (-X -> +Y)
-  n += glm::cross(glm::vec3(1.0, scale*(h[index+dim.y]-h[index]), 0.0), glm::vec3(0.0, scale*(h[index-1]-h[index]), -1.0));
-  n += glm::cross(glm::vec3(-1.0, scale*(h[index-dim.y]-h[index]), 0.0), glm::vec3(0.0, scale*(h[index+1]-h[index]), 1.0));
+  n += glm::cross(glm::vec3(1.0, scale*(h[index+s]-h[index]), 0.0), glm::vec3(0.0, scale*(h[index-1]-h[index]), -1.0));
+  n += glm::cross(glm::vec3(-1.0, scale*(h[index-s]-h[index]), 0.0), glm::vec3(0.0, scale*(h[index+1]-h[index]), 1.0));
 
   return glm::normalize(n);
 }
 
-void Drop::descend(double* h, double* p, double* b, bool* track, double* pd, glm::ivec2 dim, double scale){
+/*
+  Normal Cache: A valid normal always points up (y > 0), so a zero vector marks
+  a stale entry. Writing a height stales the cell and its four stencil
+  neighbors, and the next read recomputes it. Without a cache (an empty
+  field, see World::normalcache) every read computes the normal.
+*/
+
+template<typename T>
+glm::vec3 surfaceNormal(int index, Field<T>& h, Field<glm::vec3>& normals, T scale){
+  if(normals.data == NULL) return surfaceNormal(index, h, scale);
+  glm::vec3& n = normals[index];
+  if(n.y == 0.0f) n = surfaceNormal(index, h, scale);
+  return n;
+}
+
+void staleNormal(int index, Field<glm::vec3>& normals){
+  if(normals.data == NULL) return;
+  normals[index] = glm::vec3(0.0f);
+  normals[index+1] = glm::vec3(0.0f);
+  normals[index-1] = glm::vec3(0.0f);
+  normals[index+normals.stride] = glm::vec3(0.0f);
+  normals[index-normals.stride] = glm::vec3(0.0f);
+}
+
+template<typename T>
+void Drop<T>::descend(Field<T>& h, Field<glm::vec3>& normals, Path<T>& p, Field<T>& b, std::vector<int>& track, Field<T>& pd, T scale, Lakes<T>* lakes, Depressions<T>* spills, Stats* stats){
 
   glm::ivec2 ipos;
+  glm::vec2 lpos, lspeed;
 
   while(volume > minVol){
 
+    if(stats) stats->steps++;
+
     //Initial Position
     ipos = pos;
-    int ind = ipos.x*dim.y+ipos.y;
+    lpos = pos;
+    lspeed = speed;
+    int ind = h.index(ipos);
 
     //Add to Path
-    track[ind] = true;
+    p.visit(ind, track);
 
-    glm::vec3 n = surfaceNormal(ind, h, dim, scale);
+    glm::vec3 n = surfaceNormal(ind, h, normals, scale);
 
     //Effective Parameter Set
     /* Higher plant density means less erosion */
-    double effD = depositionRate*max(0.0, 1.0-pd[ind]);
+    T effD = depositionRate*max(T(0), T(1)-pd[ind]);
 
     /* Lower Friction, Lower Evaporation in Streams
     makes particles prefer established streams -> "curvy" */
-    double effF = friction*(1.0-0.5*p[ind]);
-    double effR = evapRate*(1.0-0.2*p[ind]);
+    T effF = friction*(T(1)-T(0.5)*p[ind]);
+    T effR = evapRate*(T(1)-T(0.2)*p[ind]);
 
     //Newtonian Mechanics
     glm::vec2 acc = glm::vec2(n.x, n.z)/(float)(volume*density);
     speed += dt*acc;
     pos   += dt*speed;
-    speed *= (1.0-dt*effF);
+    speed *= (T(1)-dt*effF);
 
     //New Position
-    int nind = (int)pos.x*dim.y+(int)pos.y;
+    int nind = h.index(pos);
 
     //Out-Of-Bounds
     if(!glm::all(glm::greaterThanEqual(pos, glm::vec2(0))) ||
-       !glm::all(glm::lessThan((glm::ivec2)pos, dim))){
+       !glm::all(glm::lessThan((glm::ivec2)pos, h.dim))){
+         if(stats) stats->outofbounds++;
          volume = 0.0;
          break;
        }
 
+    //Entered a new Block: page in the next one along the Speed
+    if(scratch && glm::ivec2(pos)/Scratch::block() != ipos/Scratch::block()){
+      glm::ivec2 next = (glm::ivec2(pos)/Scratch::block() + glm::ivec2(glm::sign(speed)))*Scratch::block();
+      scratch->ahead(next, next + Scratch::block());
+    }
+
+    //Left the Region: Undo the Step, the serial Pass redoes it
+    if(confined && !inside(pos)){
+      pos = lpos;
+      speed = lspeed;
+      parked = true;
+      break;
+    }
+
     //Particle is not accelerated
     if(p[nind] > 0.3 && length(acc) < 0.01)
       break;
 
     //Particle enters Pool
-    if(b[nind] > 0.0)
+    if(b[nind] > 0.0){
+      if(stats) stats->poolentries++;
       break;
+    }
 
     //Mass-Transfer (in MASS)
-    double c_eq = max(0.0, glm::length(speed)*(h[ind]-h[nind]));
-    double cdiff = c_eq - sediment;
+    T c_eq = max(T(0), (T)glm::length(speed)*(h[ind]-h[nind]));
+    T cdiff = c_eq - sediment;
     sediment += dt*effD*cdiff;
     h[ind] -= volume*dt*effD*cdiff;
+    if(spans) spans->mark(ind);
+    if(lakes) lakes->touch(ind, h, b);
+    if(spills) spills->touch(ind);
+    staleNormal(ind, normals);
 
     //Evaporate (Mass Conservative)
-    sediment /= (1.0-dt*effR);
-    volume *= (1.0-dt*effR);
+    sediment /= (T(1)-dt*effR);
+    volume *= (T(1)-dt*effR);
   }
 };
 
-void Drop::flood(double* h, double* p, glm::ivec2 dim){
+/*
+  Flood Scratch, one per Thread and reused by every Flood. The cells a fill
+  has tried are kept in an open-addressing hash set (linear probing) sized
+  to the fill, not to the map, so a thread holds memory in proportion to
+  the largest flood it ran. A new fill only clears the slots the last one
+  used.
+*/
+
+struct FloodBuffer{
+  std::vector<int> slots = std::vector<int>(1024, -1);  //Tried Cells, -1: Empty
+  std::vector<int> used;                //Occupied Slots
+  int bits = 10;                        //log2 of the Slot Count
+  std::vector<int> stack;
+  std::vector<int> set;
 
-  //Current Height
-  index = (int)pos.x*dim.y + (int)pos.y;
-  double plane = h[index] + p[index];
-  double initialplane = plane;
+  void next(){
+    for(auto& k: used)
+      slots[k] = -1;
+    used.clear();
+  }
 
-  //Floodset
-  std::vector<int> set;
+  //Mark a Cell as tried, false if it already was
+  bool tried(int i){
+    if(2*used.size() >= slots.size()) grow();
+    const unsigned int mask = (1u << bits) - 1;
+    unsigned int k = ((unsigned int)i*2654435761u) >> (32 - bits);
+    while(slots[k] >= 0){
+      if(slots[k] == i) return true;
+      k = (k+1) & mask;
+    }
+    slots[k] = i;
+    used.push_back(k);
+    return false;
+  }
+
+  void grow(){
+    std::vector<int> cells;
+    for(auto& k: used)
+      cells.push_back(slots[k]);
+    bits++;
+    slots.assign((size_t)1 << bits, -1);
+    used.clear();
+    for(auto& i: cells)
+      tried(i);
+  }
+};
+
+FloodBuffer& floodBuffer(){
+  static thread_local FloodBuffer buffer;
+  return buffer;
+}
+
+template<typename T>
+void Drop<T>::flood(Field<T>& h, Field<T>& p, Lakes<T>* lakes, Depressions<T>* spills, Stats* stats){
+
+  if(spills){
+    route(h, p, *spills, lakes, stats);
+    return;
+  }
+
+  if(stats) stats->floods++;
+
+  //Current Height
+  index = h.index(pos);
+  T plane = h[index] + p[index];
+  T initialplane = plane;
+
+  //Floodset (Per-Thread Scratch)
+  FloodBuffer& buffer = floodBuffer();
+  std::vector<int>& set = buffer.set;
+  std::vector<int>& stack = buffer.stack;
   int fail = 10;
 
   //Iterate
   while(volume > minVol && fail){
 
+    if(stats) stats->flooditerations++;
+
     set.clear();
-    const int size = (int)dim.x*dim.y;
-    //bool tried[size] = {false};
-	bool* tried = new bool[size];
-	for (int i = 0; i < size; ++i) {
-		tried[i] = false;
-	}
-	int drain;
-	bool drainfound = false;
+    buffer.next();
+    int drain = -1;
+    bool drainfound = false;
+    bool escaped = false;
+
+    //Depth-First Fill on an explicit Stack (Visits in the Order of the old Recursion)
+    stack.clear();
+    stack.push_back(index);
+    while(!stack.empty()){
 
-    std::function<void(int)> fill = [&](int i){
+      int i = stack.back();
+      stack.pop_back();
 
       //Out of Bounds
-		if (i < 0 || i >= size) {
-			return;
-		}
+      if(!h.contains(i))
+        continue;
+
+      //Out of Region
+      if(confined && !inside(h.pos(i))){
+        escaped = true;
+        break;
+      }
 
       //Position has been tried
-		if (tried[i]) {
-			return;
-		}
-		tried[i] = true;
+      if(buffer.tried(i))
+        continue;
 
       //Wall / Boundary
-		if (plane < h[i] + p[i]) {
-			return;
-		}
+      if(plane < h[i] + p[i])
+        continue;
 
       //Drainage Point
       if(initialplane > h[i] + p[i]){
@@ -156,46 +304,53 @@ void Drop::flood(double* h, double* p, glm::ivec2 dim){
           drain = i;
 
         drainfound = true;
-        return;
+        continue;
       }
 
-      //Part of the Pool
+      //Part of the Pool, Neighbors pushed in Reverse Order
       set.push_back(i);
-      fill(i+dim.y);    //Fill Neighbors
-      fill(i-dim.y);
-      fill(i+1);
-      fill(i-1);
-      fill(i+dim.y+1);  //Diagonals (Improves Drainage)
-      fill(i-dim.y-1);
-      fill(i+dim.y-1);
-      fill(i-dim.y+1);
-    };
-
-    //Perform Flood
-    fill(index);
-	delete[] tried;
+      stack.push_back(i-h.stride+1);
+      stack.push_back(i+h.stride-1);
+      stack.push_back(i-h.stride-1);
+      stack.push_back(i+h.stride+1);  //Diagonals (Improves Drainage)
+      stack.push_back(i-1);
+      stack.push_back(i+1);
+      stack.push_back(i-h.stride);
+      stack.push_back(i+h.stride);    //Fill Neighbors
+    }
+
+    //Pool reaches beyond the Region: Hand over to the serial Pass
+    if(escaped){
+      parked = true;
+      return;
+    }
 
     //Drainage Point
     if(drainfound){
 
+      if(stats) stats->drains++;
+
       //Set the Drop Position and Evaporate
-      pos = glm::vec2(drain/dim.y, drain%dim.y);
+      pos = h.pos(drain);
 
       //Set the New Waterlevel (Slowly)
-      double drainage = 0.001;
-      plane = (1.0-drainage)*initialplane + drainage*(h[drain] + p[drain]);
+      T drainage = 0.001;
+      plane = (T(1)-drainage)*initialplane + drainage*(h[drain] + p[drain]);
 
       //Compute the New Height
-      for(auto& s: set)
-        p[s] = (plane > h[s])?(plane-h[s]):0.0;
+      for(auto& s: set){
+        p[s] = (plane > h[s])?(plane-h[s]):T(0);
+        if(spans) spans->mark(s);
+        if(lakes) lakes->touch(s, h, p, true);
+      }
 
       //Remove Sediment
-      sediment *= 0.1;
+      sediment *= T(0.1);
       break;
     }
 
     //Get Volume under Plane
-    double tVol = 0.0;
+    T tVol = 0.0;
     for(auto& s: set)
       tVol += volumeFactor*(plane - (h[s]+p[s]));
 
@@ -203,8 +358,11 @@ void Drop::flood(double* h, double* p, glm::ivec2 dim){
     if(tVol <= volume && initialplane < plane){
 
       //Raise water level to plane height
-      for(auto& s: set)
+      for(auto& s: set){
         p[s] = plane - h[s];
+        if(spans) spans->mark(s);
+        if(lakes) lakes->touch(s, h, p, true);  //Below the Spill Height: Map stays valid
+      }
 
       //Adjust Drop Volume
       volume -= tVol;
@@ -216,10 +374,126 @@ void Drop::flood(double* h, double* p, glm::ivec2 dim){
 
     //Adjust Planes
     initialplane = (plane > initialplane)?plane:initialplane;
-    plane += 0.5*(volume-tVol)/(double)set.size()/volumeFactor;
+    plane += T(0.5)*(volume-tVol)/(T)set.size()/volumeFactor;
   }
 
   //Couldn't place the volume (for some reason)- so ignore this drop.
-  if(fail == 0)
-    volume = 0.0;
+  if(fail == 0){
+    if(stats) stats->exhausted++;
+    volume = T(0);
+  }
+}
+
+/*
+  Flood through the Depression Map: the depression of the cell fills up to its
+  spill height and the water then leaves through the stored outlet, in one
+  pass without retries. The surface rises from the cell like a priority flood,
+  taking in the lowest cell around it, until the volume is used up, the spill
+  height is reached, or a cell around it lies below the surface. There the
+  water spills over an inner rim into the next basin, like a drain. An outlet
+  that is no longer lower is stale, and the surface rises without the cap.
+  Pools filled to at most the spill height leave the map valid.
+*/
+
+template<typename T>
+void Drop<T>::route(Field<T>& h, Field<T>& p, Depressions<T>& spills, Lakes<T>* lakes, Stats* stats){
+
+  if(stats){
+    stats->floods++;
+    stats->flooditerations++;
+  }
+
+  auto surface = [&](int i){ return h[i] + p[i]; };
+  const T tolerance = Depressions<T>::tolerance;
+
+  //Spill Height and Outlet, recomputed if the Blocks are dirty
+  index = h.index(pos);
+  spills.refresh(index, h, p);
+  if(spills.outlet[index] >= 0)
+    spills.refresh(spills.outlet[index], h, p);
+  T spill = spills.spill[index];
+  int outlet = spills.outlet[index];
+  bool capped = true;
+  if(outlet >= 0 && !(surface(outlet) < spill)){
+    spill = std::numeric_limits<T>::max();
+    capped = false;
+  }
+
+  //Rim: Min-Heap of the Cells around the Surface (Per-Thread Scratch)
+  FloodBuffer& buffer = floodBuffer();
+  std::vector<int>& set = buffer.set;
+  std::vector<int>& rim = buffer.stack;
+  auto higher = [&](int a, int b){
+    return (surface(a) > surface(b)) || (surface(a) == surface(b) && a > b);
+  };
+  set.clear();
+  buffer.next();
+  rim.clear();
+  rim.push_back(index);
+  buffer.tried(index);
+
+  const int s = h.stride;
+  const int n[8] = {s, -s, 1, -1, s+1, -s-1, s-1, -s+1};
+
+  T level = surface(index);
+  bool leaves = false;                  //Reached the Spill Height
+  int drain = -1;
+
+  while(!rim.empty() && volume > minVol){
+
+    const int c = rim.front();
+
+    //Below the Surface: spill over an inner Rim
+    if(surface(c) < level - tolerance){
+      drain = c;
+      break;
+    }
+
+    //Raise the Surface to the Cell, at most to the Spill Height
+    T top = (surface(c) > level)?surface(c):level;
+    top = (top < spill)?top:spill;
+    T cost = volumeFactor*(top - level)*(T)set.size();
+    if(cost > volume){
+      level += volume/volumeFactor/(T)set.size();
+      volume = T(0);
+      break;
+    }
+    volume -= cost;
+    level = top;
+
+    if(level >= spill - tolerance){
+      leaves = true;
+      break;
+    }
+
+    //Take the Cell in, add its Neighbors to the Rim
+    std::pop_heap(rim.begin(), rim.end(), higher);
+    rim.pop_back();
+    set.push_back(c);
+    for(auto& o: n){
+      int j = c+o;
+      if(!h.contains(j) || buffer.tried(j)) continue;
+      rim.push_back(j);
+      std::push_heap(rim.begin(), rim.end(), higher);
+    }
+  }
+
+  //Write the Surface
+  for(auto& i: set){
+    p[i] = (level > h[i])?(level-h[i]):T(0);
+    if(spans) spans->mark(i);
+    if(lakes) lakes->touch(i, h, p, true);
+    if(!capped) spills.touch(i);        //Above a stale Spill Height
+  }
+
+  //Leave through the Outlet (or off the Map), or over the inner Rim
+  if(leaves && outlet < 0)
+    volume = T(0);
+  else if(leaves)
+    drain = outlet;
+  if(drain >= 0){
+    if(stats) stats->drains++;
+    pos = h.pos(drain);
+    sediment *= T(0.1);
+  }
 }
@@ -1,29 +1,95 @@
-#include "vegetation.h"
+#include <random>
+#include <sstream>
+#include <deque>
+#include <functional>
 #include "water.h"
+#include "packet.h"
+#include "vegetation.h"
 #define NOISE_STATIC 1
 
+//Scalar Type of all Fields, T is float or double
+template<typename T>
 class World{
 public:
   //Constructor
+  void resize(glm::ivec2 size);         //Allocate the Fields
   void generate();                      //Initialize Heightmap
   void erode(int cycles);               //Erode with N Particles
   void grow();
+  void features();                      //Allocate or free the Fields of optional Features
+  size_t bytes() const;                 //Memory of all Fields and Trees
+
+  //Snapshot Files (see archive.h)
+  bool save(std::string file);
+  bool load(std::string file);          //Fields view the mapped File (or copy it into Scratch)
+  void release();                       //Fields leave the mapped File
+
+  //Erosion Helpers
+  void settle(Drop<T>& drop, std::vector<int>& track, Stats* counter);  //Run a Drop until it is used up or parked
+  void flood(Drop<T>& drop, Stats* counter);          //Flood through the Lake Registry
+  void erodeTiled(int cycles);                        //Tile-Parallel Erosion
+  void erodePacked(int cycles);                       //SIMD Drop Packets (see packet.h)
 
   int SEED = 0;
+  std::mt19937 generator;               //Spawns and Growth, seeded by generate, kept in Snapshots
+  int draw(int n){ return (int)(generator()%(unsigned int)n); }  //In [0, n)
   glm::ivec2 dim = glm::vec2(256, 256);  //Size of the heightmap array
 
-  double scale = 100.0;                  //"Physical" Height scaling of the map
-  double heightmap[256*256] = {0.0};    //Flat Array
+  T scale = 100.0;                       //"Physical" Height scaling of the map
+  Field<T> heightmap;                   //Padded Row-Major Fields (see field.h)
+  Field<glm::vec3> normals;             //Cached Surface Normals (see water.h)
+  bool normalcache = true;              //Keep the Normal Cache (12 B per Cell)
 
-  double waterpath[256*256] = {0.0};    //Water Path Storage (Rivers)
-  double waterpool[256*256] = {0.0};    //Water Pool Storage (Lakes / Ponds)
+  Path<T> waterpath;                    //Water Path Storage (Rivers, see path.h)
+  Field<T> waterpool;                   //Water Pool Storage (Lakes / Ponds)
 
   //Trees
-  std::vector<Plant> trees;
-  double plantdensity[256*256] = {0.0}; //Density for Plants
+  Plants trees;                         //Structure of Arrays (see vegetation.h)
+  Field<T> plantdensity;                //Density for Plants
+  Roots<T> roots;                       //Keeps plantdensity (see vegetation.h)
+
+  std::shared_ptr<Mapping> mapping;     //File behind loaded Fields (NULL: own Memory)
+
+  //Out-of-Core Fields (see archive.h)
+  std::string scratchfile;              //Prefix of the Scratch Files (Empty: Fields on the Heap)
+  std::shared_ptr<Scratch> scratch;
+  std::shared_ptr<Scratch> files(){ return scratchfile.empty()?NULL:std::make_shared<Scratch>(scratchfile); }
 
   //Erosion Process
   bool active = false;
+  std::vector<int> track;               //Cells passed in this Call
+  std::vector<std::vector<int>> tracks; //Per Tile, merged after each Color
+  Spans changed;                        //Cells of Heights, Pools, Path and Trees written
+                                        //since the Reader cleared it (see field.h)
+
+  //Tile-Parallel Erosion
+  bool tiled = false;                   //Erode Tiles on all Cores
+  int tilesize = 32;                    //Edge Length of a Tile
+  int threads = 0;                      //Worker Count for Tiles and generate (0: Hardware Concurrency)
+  static const int GENBLOCK = 16;       //Rows per generate Task
+  unsigned int epoch = 0;               //Tiled Erosion Calls (Seeds the Tiles)
+
+  //Packet Erosion
+  bool packed = false;                  //Step Drops in AVX2 Packets (Serial without AVX2)
+
+  //Lake Registry (see lakes.h)
+  bool basins = false;                  //Raise known Lakes without a Flood
+  Lakes<T> lakes;
+  Lakes<T>* registry(){ return (basins && !tiled)?&lakes:NULL; }
+
+  //Depression Map (see depressions.h)
+  bool spillmap = false;                //Floods jump to precomputed Outlets
+  Depressions<T> depressions;
+  Depressions<T>* spills(){ return (spillmap && !tiled)?&depressions:NULL; }
+
+  //Erosion Counters (see stats.h)
+  bool counting = false;                //Count and time every erode Call
+  Stats stats;                          //Counters of the last Call
+  std::deque<Stats> history;            //Last HISTORY counted Calls, oldest first
+  std::function<void(const Stats&)> log;  //Gets every counted Call as it ends (see Stats::Log)
+  static const int HISTORY = 1024;
+  std::vector<Stats> tilestats;         //Per Tile, merged at the End of the Call
+  Stats* counters(){ return counting?&stats:NULL; }
 };
 
 /*
@@ -32,13 +98,40 @@ public:
 ===================================================
 */
 
-void World::generate(){
+template<typename T>
+void World<T>::resize(glm::ivec2 size){
+  dim = size;
+  std::shared_ptr<Scratch> next = files();
+  Scratch::resize(heightmap, dim, next.get());
+  waterpath.resize(dim, next.get());
+  Scratch::resize(waterpool, dim, next.get());
+  Scratch::resize(plantdensity, dim, next.get());
+  roots.resize(dim, next.get());
+  normals.release();                    //Optional, see features()
+  lakes.release();
+  depressions.release();
+  trees.clear();
+  changed.resize(dim);
+  scratch = next;                       //No Field views the old Files or the
+  mapping.reset();                      //Snapshot anymore
+}
+
+template<typename T>
+size_t World<T>::bytes() const {
+  return heightmap.bytes() + normals.bytes() + waterpath.bytes() + waterpool.bytes()
+       + plantdensity.bytes() + roots.bytes() + lakes.bytes() + depressions.bytes()
+       + trees.bytes();
+}
+
+template<typename T>
+void World<T>::generate(){
   std::cout<<"Generating New World"<<std::endl;
+  if(heightmap.dim != dim) resize(dim);
   if(SEED == 0) SEED = time(NULL);
 
   std::cout<<"Seed: "<<SEED<<std::endl;
   //Seed the Random Generator
-  srand(SEED);
+  generator.seed(SEED);
 
   std::cout<<"... generating height ..."<<std::endl;
 
@@ -51,17 +144,44 @@ void World::generate(){
   perlin.SetFrequency(1.0);
   perlin.SetPersistence(0.5);
 
-  double min = 0.0;
-  double max = 0.0;
-  for(int i = 0; i < dim.x*dim.y; i++){
-    heightmap[i] = perlin.GetValue((i/dim.y)*(1.0/dim.x), (i%dim.y)*(1.0/dim.y), SEED);
-    if(heightmap[i] > max) max = heightmap[i];
-    if(heightmap[i] < min) min = heightmap[i];
-  }
-  //Normalize
-  for(int i = 0; i < dim.x*dim.y; i++){
-    heightmap[i] = (heightmap[i] - min)/(max - min);
+  //Noise and Range per Block of Rows, on all Threads
+  const int blocks = (dim.x + GENBLOCK - 1)/GENBLOCK;
+  std::vector<T> mins(blocks, 0.0), maxs(blocks, 0.0);
+  parallel::pool(threads).run(blocks, [&](int b){
+    T min = 0.0;
+    T max = 0.0;
+    for(int x = b*GENBLOCK; x < std::min((b+1)*GENBLOCK, dim.x); x++){
+      T* row = &heightmap[heightmap.index(glm::ivec2(x, 0))];
+      for(int y = 0; y < dim.y; y++){
+        row[y] = perlin.GetValue(x*(1.0/dim.x), y*(1.0/dim.y), SEED);
+        if(row[y] > max) max = row[y];
+        if(row[y] < min) min = row[y];
+      }
+    }
+    mins[b] = min;
+    maxs[b] = max;
+  });
+
+  T min = 0.0;
+  T max = 0.0;
+  for(int b = 0; b < blocks; b++){
+    if(maxs[b] > max) max = maxs[b];
+    if(mins[b] < min) min = mins[b];
   }
+
+  //Normalize (Contiguous Rows, so the Division is vectorized)
+  const T range = max - min;
+  parallel::pool(threads).run(blocks, [&](int b){
+    for(int x = b*GENBLOCK; x < std::min((b+1)*GENBLOCK, dim.x); x++){
+      T* row = &heightmap[heightmap.index(glm::ivec2(x, 0))];
+      for(int y = 0; y < dim.y; y++)
+        row[y] = (row[y] - min)/range;
+    }
+  });
+  normals.clear();                      //Everything Stale
+  lakes.reset();
+  depressions.reset();
+  changed.all();
 }
 
 /*
@@ -69,377 +189,574 @@ void World::generate(){
           HYDRAULIC EROSION FUNCTIONS
 ===================================================
 */
-void World::erode(int cycles){
-
-  //Track the Movement of all Particles
-  //std::vector<bool> track;
-  const int size = (int)dim.x*dim.y;
-  bool* track = new bool[size];
-  for (int i = 0; i < size; ++i) {
-    track[i] = false;
+template<typename T>
+void World<T>::erode(int cycles){
+
+  Stats* counter = counters();
+  if(counter) *counter = Stats();
+  auto start = std::chrono::steady_clock::now();
+  if(scratch) scratch->renew();         //Prefetch every Block once per Call
+  features();
+
+  //Tiles write Pools concurrently, so only the serial Paths keep Lakes
+  {
+    Stats::Timer timer(counter, Stats::MAPS);
+    if(registry() == NULL) lakes.clear(heightmap, waterpool);
+    if(spills() == NULL) depressions.reset();
+    else depressions.update(heightmap, waterpool);
   }
-  //bool track[dim.x*dim.y] = {false};
+
+  if(tiled) erodeTiled(cycles);
+  else if(packed && DropPacket<T>::SIMD) erodePacked(cycles);
 
   //Do a series of iterations!
-  for(int i = 0; i < cycles; i++){
+  else for(int i = 0; i < cycles; i++){
 
     //Spawn New Particle
-    glm::vec2 newpos = glm::vec2(rand()%(int)dim.x, rand()%(int)dim.y);
-    Drop drop(newpos);
+    glm::vec2 newpos = glm::vec2(draw(dim.x), draw(dim.y));
+    Drop<T> drop(newpos);
+    drop.scratch = scratch.get();
+    drop.spans = &changed;
+    if(counter) counter->spawned++;
+    settle(drop, track, counter);
+  }
+
+  {
+    Stats::Timer timer(counter, Stats::MAPS);
+    lakes.flush(heightmap, waterpool);
+    changed.merge(lakes.written);
+    lakes.written.clear();
+  }
+  if(counter) counter->touched = track.size();
+
+  //Update Path (Tracked Cells only)
+  {
+    Stats::Timer timer(counter, Stats::PATH);
+    for(auto& i: track)
+      changed.mark(i);
+    waterpath.update(track);
+  }
+
+  if(counter){
+    counter->time[Stats::TOTAL] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(log) log(*counter);
+    history.push_back(*counter);
+    if(history.size() > (size_t)HISTORY) history.pop_front();
+  }
+}
+
+template<typename T>
+void World<T>::settle(Drop<T>& drop, std::vector<int>& track, Stats* counter){
+
+  while(drop.volume > drop.minVol && drop.spill != 0){
+
+    if(!drop.flooding){
+      Stats::Timer timer(counter, Stats::DESCEND);
+      drop.descend(heightmap, normals, waterpath, waterpool, track, plantdensity, scale, registry(), spills(), counter);
+    }
+    if(drop.parked) return;
+
+    drop.flooding = true;
+    if(drop.volume > drop.minVol){
+      Stats::Timer timer(counter, Stats::FLOOD);
+      flood(drop, counter);
+    }
+    if(drop.parked) return;
 
+    drop.flooding = false;
+    drop.spill--;
+  }
+}
 
-    int spill = 5;
+/*
+  A drop in a known lake raises its level or leaves through its drain. Else
+  the flood runs on flushed pool depths and drops the lakes it writes into,
+  and the lake it started in is registered for the next drop.
 
-    while(drop.volume > drop.minVol && spill != 0){
+  The registry compares surfaces up to rounding, where the flood takes a cell
+  an ulp below the plane for a drain. Drops that would bounce between such
+  cells until they run out of spills fill the lake instead.
+*/
 
-      drop.descend(heightmap, waterpath, waterpool, track, plantdensity, dim, scale);
+template<typename T>
+void World<T>::flood(Drop<T>& drop, Stats* counter){
 
-      if(drop.volume > drop.minVol)
-        drop.flood(heightmap, waterpool, dim);
+  if(registry() == NULL){
+    drop.flood(heightmap, waterpool, NULL, spills(), counter);
+    return;
+  }
 
-      spill--;
+  int i = heightmap.index(drop.pos);
+  int drain;
+  if(lakes.add(i, drop.volume, drop.volumeFactor, heightmap, waterpool, drain)){
+    if(counter) counter->floods++;
+    if(drain >= 0){
+      if(counter) counter->drains++;
+      drop.pos = heightmap.pos(drain);
+      drop.sediment *= T(0.1);
     }
+    return;
   }
 
-  //Update Path
-  double lrate = 0.01;
-  for(int i = 0; i < dim.x*dim.y; i++)
-    waterpath[i] = (1.0-lrate)*waterpath[i] + lrate*((track[i])?1.0:0.0);
-  delete[] track;
+  lakes.touch(i, heightmap, waterpool, true);
+  lakes.flush(heightmap, waterpool);
+  drop.flood(heightmap, waterpool, &lakes, spills(), counter);
+  lakes.capture(i, heightmap, waterpool);
+}
+
+/*
+  Lanes only descend. When a lane stops, its drop finishes the round on the
+  scalar path (flood, spill count) exactly like settle, and either goes back
+  into its lane or frees it for the next spawn.
+*/
+
+template<typename T>
+void World<T>::erodePacked(int cycles){
+
+  const int N = DropPacket<T>::N;
+  Stats* counter = counters();
+  DropPacket<T> packet;
+  packet.spans = &changed;
+  int spill[N];
+  bool held[N] = {false};
+  int spawned = 0;
+
+  while(true){
+
+    //Hand Stopped Lanes to the Scalar Path, then Refill
+    bool any = false;
+    for(int l = 0; l < N; l++){
+
+      if(held[l] && !packet.active(l)){
+        Drop<T> drop(glm::vec2(0.0));
+        packet.store(l, drop);
+        drop.spill = spill[l];
+        drop.scratch = scratch.get();
+        drop.spans = &changed;
+
+        if(drop.volume > drop.minVol){
+          Stats::Timer timer(counter, Stats::FLOOD);
+          flood(drop, counter);
+        }
+        drop.spill--;
+
+        held[l] = (drop.volume > drop.minVol && drop.spill != 0);
+        if(held[l]){
+          packet.load(l, drop);
+          spill[l] = drop.spill;
+        }
+      }
+
+      if(!held[l] && spawned < cycles){
+        glm::vec2 newpos = glm::vec2(draw(dim.x), draw(dim.y));
+        Drop<T> drop(newpos);
+        spawned++;
+        if(counter) counter->spawned++;
+        packet.load(l, drop);
+        spill[l] = drop.spill;
+        held[l] = true;
+      }
+
+      any = any || held[l];
+    }
+
+    if(!any) break;
+    Stats::Timer timer(counter, Stats::DESCEND);
+    packet.step(heightmap, normals, waterpath, waterpool, track, plantdensity, scale, registry(), spills(), scratch.get(), counter);
+  }
 }
 
-void World::grow(){
+/*
+  Tiles are colored by the parity of their tile coordinates. Tiles of one color
+  are a full tile apart, so a drop may wander half a tile (minus the normal
+  stencil) past its own tile without meeting a drop from a concurrent tile.
+  Drops that leave this region, or flood a pool that reaches past it, are
+  parked and finished serially, in tile order, before the next color runs.
+
+  Spawns come from per-tile generators seeded by (SEED, epoch, tile), so the
+  result does not depend on the thread count.
+*/
+
+template<typename T>
+void World<T>::erodeTiled(int cycles){
+
+  //Even Tile Counts keep wrapped Neighbor Reads on the Map Edge off-color
+  glm::ivec2 tiles = (dim + tilesize - 1)/tilesize;
+  tiles += tiles%2;
+  const int ntiles = tiles.x*tiles.y;
+  const int margin = tilesize/2-1;
+
+  std::vector<std::vector<Drop<T>>> parked(ntiles);
+  std::vector<Spans> regions(ntiles);   //Rows a Tile may write, merged after each Color
+  tracks.resize(ntiles);
+
+  Stats* counter = counters();
+  if(counter) tilestats.assign(ntiles, Stats());
+
+  auto members = [&](int color){
+    std::vector<int> group;
+    for(int t = 0; t < ntiles; t++)
+      if((t/tiles.y)%2 == color/2 && (t%tiles.y)%2 == color%2)
+        group.push_back(t);
+    return group;
+  };
+
+  //Regions the Drops of Tiles may touch, paged in before they run
+  auto ahead = [&](std::vector<int> group){
+    for(auto& t: group){
+      glm::ivec2 origin = glm::ivec2(t/tiles.y, t%tiles.y)*tilesize;
+      scratch->ahead(origin - margin - 1, origin + tilesize + margin + 1);
+    }
+  };
+
+  if(scratch) ahead(members(0));
+  for(int color = 0; color < 4; color++){
+
+    std::vector<int> group = members(color);
+    if(scratch && color < 3) ahead(members(color+1));
+
+    parallel::pool(threads).run(group.size(), [&](int g){
+
+      const int t = group[g];
+      glm::ivec2 origin = glm::ivec2(t/tiles.y, t%tiles.y)*tilesize;
+      glm::ivec2 extent = glm::min(origin + tilesize, dim) - origin;
+      if(extent.x <= 0 || extent.y <= 0) return;
+
+      std::seed_seq seed{(unsigned int)SEED, epoch, (unsigned int)t};
+      std::mt19937 gen(seed);
+
+      Stats* tilecounter = (counter)?&tilestats[t]:NULL;
+      glm::ivec2 lower = glm::max(origin - margin, glm::ivec2(0));
+      glm::ivec2 upper = glm::min(origin + tilesize + margin, dim);
+      regions[t].resize(dim, lower.x, upper.x - lower.x);
+      regions[t].clear();
+
+      int n = cycles/ntiles + ((t < cycles%ntiles)?1:0);
+      for(int i = 0; i < n; i++){
+
+        //Spawn New Particle inside the Tile
+        glm::vec2 newpos = origin + glm::ivec2(gen()%extent.x, gen()%extent.y);
+        Drop<T> drop(newpos);
+        drop.confined = true;
+        drop.lower = lower;
+        drop.upper = upper;
+        drop.spans = &regions[t];
+        drop.scratch = scratch.get();
+        if(tilecounter) tilecounter->spawned++;
+
+        settle(drop, tracks[t], tilecounter);
+        if(drop.parked)
+          parked[t].push_back(drop);
+      }
+    });
+
+    //Finish the Parked Drops without Confinement
+    for(auto& t: group){
+      track.insert(track.end(), tracks[t].begin(), tracks[t].end());
+      tracks[t].clear();
+      changed.merge(regions[t]);
+      for(auto& drop: parked[t]){
+        drop.confined = false;
+        drop.parked = false;
+        drop.spans = &changed;
+        settle(drop, track, counter);
+      }
+      parked[t].clear();
+    }
+  }
+
+  if(counter)
+    for(auto& s: tilestats)
+      *counter += s;
+
+  epoch++;
+}
+
+/*
+  The normal cache, the lake registry and the depression map need 12, 4 and
+  16 bytes per cell. Their fields are allocated (zeroed, i.e. stale or empty)
+  when the feature is first used and freed once it is off. Lakes are written
+  back to the pools before they are freed.
+*/
+
+template<typename T>
+void World<T>::features(){
+  if(changed.count != dim.x || changed.height != dim.y) changed.resize(dim);
+
+  if(normalcache && normals.dim != dim) Scratch::resize(normals, dim, scratch.get());
+  if(!normalcache && normals.data != NULL) Scratch::release(normals, scratch.get());
+
+  if(registry() != NULL && lakes.id.dim != dim) lakes.resize(dim, scratch.get());
+  if(registry() == NULL && lakes.id.data != NULL){
+    lakes.flush(heightmap, waterpool);
+    changed.merge(lakes.written);
+    lakes.release(scratch.get());
+  }
+
+  if(spills() != NULL && depressions.spill.dim != dim) depressions.resize(dim, scratch.get());
+  if(spills() == NULL && depressions.spill.data != NULL) depressions.release(scratch.get());
+}
+
+template<typename T>
+void World<T>::grow(){
+
+  features();
 
   //Random Position
   {
-    int i = rand()%(dim.x*dim.y);
-    glm::vec3 n = surfaceNormal(i, heightmap, dim, scale);
+    int i = draw(dim.x*dim.y);
+    i = heightmap.index(glm::ivec2(i/dim.y, i%dim.y));
+    glm::vec3 n = surfaceNormal(i, heightmap, normals, scale);
 
     if( waterpool[i] == 0.0 &&
         waterpath[i] < 0.2 &&
         n.y > 0.8 ){
 
-        Plant ntree(i, dim);
-        ntree.root(plantdensity, dim, 1.0);
-        trees.push_back(ntree);
+        Plant ntree(i, heightmap);
+        roots.add(ntree.index, 1.0);
+        changed.mark(ntree.index);
+        trees.push(ntree);
     }
   }
 
-  //Loop over all Trees
-  for(int i = 0; i < trees.size(); i++){
-
-    //Grow the Tree
-    trees[i].grow();
+  //Loop over all Trees, newborns included, and move the Survivors down in
+  //Order: one Pass, instead of an Erase per Death
+  size_t alive = 0;
+  for(size_t i = 0; i < trees.count(); i++){
 
     //Spawn a new Tree!
-    if(rand()%50 == 0){
+    if(draw(50) == 0){
       //Find New Position
-      glm::vec2 npos = trees[i].pos + glm::vec2(rand()%9-4, rand()%9-4);
+      glm::vec2 npos = trees.pos[i] + glm::vec2(draw(9)-4, draw(9)-4);
 
       //Check for Out-Of-Bounds
       if( npos.x >= 0 && npos.x < dim.x &&
           npos.y >= 0 && npos.y < dim.y ){
 
-        Plant ntree(npos, dim);
-        glm::vec3 n = surfaceNormal(ntree.index, heightmap, dim, scale);
+        Plant ntree(npos, heightmap);
+        glm::vec3 n = surfaceNormal(ntree.index, heightmap, normals, scale);
 
         if( waterpool[ntree.index] == 0.0 &&
             waterpath[ntree.index] < 0.2 &&
             n.y > 0.8 &&
-            (double)(rand()%1000)/1000.0 > plantdensity[ntree.index]){
-              ntree.root(plantdensity, dim, 1.0);
-              trees.push_back(ntree);
+            (T)draw(1000)/T(1000) > roots.at(ntree.index)){
+              roots.add(ntree.index, 1.0);
+              changed.mark(ntree.index);
+              trees.push(ntree);
             }
       }
     }
 
     //If the tree is in a pool or in a stream, kill it
-    if(waterpool[trees[i].index] > 0.0 ||
-       waterpath[trees[i].index] > 0.2 ||
-       rand()%1000 == 0 ){ //Random Death Chance
-         trees[i].root(plantdensity, dim, -1.0);
-         trees.erase(trees.begin()+i);
-         i--;
+    if(waterpool[trees.index[i]] > 0.0 ||
+       waterpath[trees.index[i]] > 0.2 ||
+       draw(1000) == 0 ){ //Random Death Chance
+         roots.add(trees.index[i], -1.0);
+         changed.mark(trees.index[i]);
+         continue;
        }
+    trees.move(i, alive++);
   }
+  trees.resize(alive);
+
+  //Grow the Survivors (nothing above reads the Size)
+  trees.grow();
+  roots.apply(plantdensity);
 
 };
 
 /*
 ===================================================
-                RENDERING STUFF
+          WORLD SNAPSHOT FUNCTIONS
 ===================================================
 */
 
-World world;
-
-int WIDTH = 1000;
-int HEIGHT = 1000;
-
-bool paused = true;
-
-float zoom = 0.2;
-float zoomInc = 20.0;
-
-//Rotation and View
-float rotation = 0.0f;
-glm::vec3 cameraPos = glm::vec3(50, 50, 50);
-glm::vec3 lookPos = glm::vec3(0, 0, 0);
-glm::mat4 camera = glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0));
-glm::mat4 projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
-
-glm::vec3 viewPos = glm::vec3(world.dim.x/2.0, world.scale/2.0, world.dim.y/2.0);
-
-//Shader Stuff
-float steepness = 0.8;
-glm::vec3 flatColor = glm::vec3(0.40, 0.60, 0.25);
-glm::vec3 waterColor = glm::vec3(0.17, 0.40, 0.44);
-glm::vec3 steepColor = glm::vec3(0.7);
-//glm::vec3 steepColor = glm::vec3(0.78, 0.6, 0.168);
-//glm::vec3 flatColor = glm::vec3(0.84, 0.65, 0.36);
-
-//Lighting and Shading
-glm::vec3 skyCol = glm::vec4(0.64, 0.75, 0.9, 1.0f);
-glm::vec3 lightPos = glm::vec3(-100.0f, 100.0f, -150.0f);
-glm::vec3 lightCol = glm::vec3(1.0f, 1.0f, 0.9f);
-float lightStrength = 1.4;
-glm::mat4 depthModelMatrix = glm::mat4(1.0);
-glm::mat4 depthProjection = glm::ortho<float>(-300, 300, -300, 300, 0, 800);
-glm::mat4 depthCamera = glm::lookAt(lightPos, glm::vec3(0), glm::vec3(0,1,0));
-bool viewmap = true;
-
-glm::mat4 biasMatrix = glm::mat4(
-    0.5, 0.0, 0.0, 0.0,
-    0.0, 0.5, 0.0, 0.0,
-    0.0, 0.0, 0.5, 0.0,
-    0.5, 0.5, 0.5, 1.0
-);
-
-std::function<void(Model* m)> constructor = [&](Model* m){
-  //Clear the Containers
-  m->indices.clear();
-  m->positions.clear();
-  m->normals.clear();
-  m->colors.clear();
-
-  //Loop over all positions and add the triangles!
-  for(int i = 0; i < world.dim.x-1; i++){
-    for(int j = 0; j < world.dim.y-1; j++){
-
-      //Get Index
-      int ind = i*world.dim.y+j;
-
-      //Add to Position Vector
-      glm::vec3 a = glm::vec3(i, world.scale*world.heightmap[ind], j);
-      glm::vec3 b = glm::vec3(i+1, world.scale*world.heightmap[ind+world.dim.y], j);
-      glm::vec3 c = glm::vec3(i, world.scale*world.heightmap[ind+1], j+1);
-      glm::vec3 d = glm::vec3(i+1, world.scale*world.heightmap[ind+world.dim.y+1], j+1);
-
-      //Check if the Surface is Water
-      bool water1 = (world.waterpool[ind] > 0.0 &&
-                     world.waterpool[ind+world.dim.y] > 0.0 &&
-                     world.waterpool[ind+1] > 0.0);
-
-      bool water2 = (world.waterpool[ind+world.dim.y] > 0.0 &&
-                     world.waterpool[ind+1] > 0.0 &&
-                     world.waterpool[ind+world.dim.y+1] > 0.0);
-
-      //Add the Pool Height
-      a += glm::vec3(0.0, world.scale*world.waterpool[ind], 0.0);
-      b += glm::vec3(0.0, world.scale*world.waterpool[ind+world.dim.y], 0.0);
-      c += glm::vec3(0.0, world.scale*world.waterpool[ind+1], 0.0);
-      d += glm::vec3(0.0, world.scale*world.waterpool[ind+world.dim.y+1], 0.0);
-
-      //UPPER TRIANGLE
-
-      //Get the Color of the Ground (Water vs. Flat)
-      glm::vec3 color;
-      double p = world.waterpath[ind];
-
-      //See if we are water or not!
-      if(water1) color = waterColor;
-      else color = glm::mix(flatColor, waterColor, p);
-
-      //Add Indices
-      m->indices.push_back(m->positions.size()/3+0);
-      m->indices.push_back(m->positions.size()/3+1);
-      m->indices.push_back(m->positions.size()/3+2);
-
-      m->positions.push_back(a.x);
-      m->positions.push_back(a.y);
-      m->positions.push_back(a.z);
-      m->positions.push_back(b.x);
-      m->positions.push_back(b.y);
-      m->positions.push_back(b.z);
-      m->positions.push_back(c.x);
-      m->positions.push_back(c.y);
-      m->positions.push_back(c.z);
-
-      glm::vec3 n1 = glm::normalize(glm::cross(a-b, c-b));
-
-      for(int i = 0; i < 3; i++){
-        m->normals.push_back(n1.x);
-        m->normals.push_back(n1.y);
-        m->normals.push_back(n1.z);
-
-        //Add the Color!
-        if(n1.y < steepness && !water1){
-          m->colors.push_back(steepColor.x);
-          m->colors.push_back(steepColor.y);
-          m->colors.push_back(steepColor.z);
-          m->colors.push_back(1.0);
-        }
-        else{
-          m->colors.push_back(color.x);
-          m->colors.push_back(color.y);
-          m->colors.push_back(color.z);
-          m->colors.push_back(1.0);
-        }
-
-      }
-
-      //Lower Triangle
-      if(water2) color = waterColor;
-      else color = glm::mix(flatColor, waterColor, p);
-
-      m->indices.push_back(m->positions.size()/3+0);
-      m->indices.push_back(m->positions.size()/3+1);
-      m->indices.push_back(m->positions.size()/3+2);
-
-      m->positions.push_back(d.x);
-      m->positions.push_back(d.y);
-      m->positions.push_back(d.z);
-      m->positions.push_back(c.x);
-      m->positions.push_back(c.y);
-      m->positions.push_back(c.z);
-      m->positions.push_back(b.x);
-      m->positions.push_back(b.y);
-      m->positions.push_back(b.z);
-
-      glm::vec3 n2 = glm::normalize(glm::cross(d-c, b-c));
-
-      for(int i = 0; i < 3; i++){
-        m->normals.push_back(n2.x);
-        m->normals.push_back(n2.y);
-        m->normals.push_back(n2.z);
-
-        if(n2.y < steepness && !water2){
-          m->colors.push_back(steepColor.x);
-          m->colors.push_back(steepColor.y);
-          m->colors.push_back(steepColor.z);
-          m->colors.push_back(1.0);
-        }
-        else{
-          m->colors.push_back(color.x);
-          m->colors.push_back(color.y);
-          m->colors.push_back(color.z);
-          m->colors.push_back(1.0);
-        }
+/*
+  The snapshot is written next to the file and renamed over it once it is
+  complete, so a failed save keeps the last one. Saving over the file a
+  world was loaded from first copies the fields out of it (see release).
+*/
 
-      }
-    }
+template<typename T>
+bool World<T>::save(std::string file){
+
+  if(mapping && Mapping::same(file, mapping->file))
+    release();
+
+  Field<T>* blocks[4] = {&heightmap, &waterpool, &waterpath.bake(), &plantdensity};
+
+  Archive::Header header = {};
+  memcpy(header.magic, Archive::MAGIC, 8);
+  header.version = Archive::VERSION;
+  header.scalar = sizeof(T);
+  header.dim[0] = dim.x;
+  header.dim[1] = dim.y;
+  header.stride = heightmap.stride;
+  header.seed = SEED;
+  header.epoch = epoch;
+  header.calls = waterpath.epoch;
+  header.scale = scale;
+
+  uint64_t offset = Archive::align(sizeof(header));
+  for(int k = 0; k < 4; k++){
+    header.blocks[k] = offset;
+    offset = Archive::align(offset + blocks[k]->bytes());
   }
-};
-
-std::function<void()> eventHandler = [&](){
-
-  if(!Tiny::event.scroll.empty()){
-
-    if(Tiny::event.scroll.back().wheel.y > 0.99 && zoom <= 0.3){
-      zoom /= 0.975;
-      projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
-    }
-    else if(Tiny::event.scroll.back().wheel.y < -0.99 && zoom > 0.005){
-      zoom *= 0.975;
-      projection = glm::ortho(-(float)WIDTH*zoom, (float)WIDTH*zoom, -(float)HEIGHT*zoom, (float)HEIGHT*zoom, -800.0f, 500.0f);
-    }
-    else if(Tiny::event.scroll.back().wheel.x < -0.8){
-      rotation += 1.5f;
-      camera = glm::rotate(camera, glm::radians(1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
-    }
-    else if(Tiny::event.scroll.back().wheel.x > 0.8){
-      rotation -= 1.5f;
-      camera = glm::rotate(camera, glm::radians(-1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
-    }
-
-    //Adjust Stuff
-    if(rotation < 0.0) rotation = 360.0 + rotation;
-    else if(rotation > 360.0) rotation = rotation - 360.0;
-    camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
-    Tiny::event.scroll.pop_back();
+  header.trees = offset;
+  header.ntrees = trees.count();
+
+  std::vector<Archive::Tree> list;
+  for(size_t i = 0; i < trees.count(); i++)
+    list.push_back({trees.pos[i].x, trees.pos[i].y, trees.index[i], trees.size[i]});
+
+  std::ostringstream state;
+  state<<generator;
+  const std::string random = state.str();
+  header.random = header.trees + list.size()*sizeof(Archive::Tree);
+  header.nrandom = random.size();
+
+  const std::string part = file + ".tmp";
+  std::ofstream out(part, std::ios::binary);
+  if(!out){
+    std::cout<<"Could not write "<<part<<std::endl;
+    return false;
   }
 
-  if(!Tiny::event.keys.empty()){
-
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_p){
-      paused = !paused;
-    }
-
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_ESCAPE){
-      viewmap = !viewmap;
-    }
-
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_SPACE){
-      viewPos += glm::vec3(0.0, 1.0, 0.0);
-    }
+  //One Pass, Zeros up to each Offset
+  const std::vector<char> zeros(Archive::PAGE, 0);
+  uint64_t at = 0;
+  auto put = [&](const char* data, uint64_t size, uint64_t offset){
+    out.write(zeros.data(), offset - at);
+    out.write(data, size);
+    at = offset + size;
+  };
+  put((const char*)&header, sizeof(header), 0);
+  for(int k = 0; k < 4; k++)
+    put(blocks[k]->block(), blocks[k]->bytes(), header.blocks[k]);
+  put((const char*)list.data(), list.size()*sizeof(Archive::Tree), header.trees);
+  put(random.data(), random.size(), header.random);
+
+  out.close();
+  if(!out || !Mapping::replace(part, file)){
+    std::cout<<"Could not write "<<file<<std::endl;
+    remove(part.c_str());
+    return false;
+  }
+  return true;
+}
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_c){
-      viewPos -= glm::vec3(0.0, 1.0, 0.0);
-    }
+/*
+  The fields view their blocks in the mapping, which lives as long as a field
+  points into it. With scratch files they are copied there instead: pages
+  the world writes through the private mapping would become anonymous
+  memory, which only swap could take out. Normals, lakes and depressions are
+  rebuilt like after generate. The generator state is in the file, so a loaded world erodes and
+  grows on exactly like the world it was saved from.
+*/
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_w){
-      viewPos -= glm::vec3(1.0, 0.0, 0.0);
-    }
+template<typename T>
+bool World<T>::load(std::string file){
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_a){
-      viewPos += glm::vec3(0.0, 0.0, 1.0);
-    }
+  auto map = std::make_shared<Mapping>(file);
+  const Archive::Header* header = (const Archive::Header*)map->data;
+  if(header == NULL || map->size < sizeof(Archive::Header) || memcmp(header->magic, Archive::MAGIC, 8) != 0){
+    std::cout<<"Not a World Snapshot: "<<file<<std::endl;
+    return false;
+  }
+  if(header->version != Archive::VERSION || header->scalar != sizeof(T)){
+    std::cout<<"Snapshot "<<file<<" has Version "<<header->version<<" with "<<header->scalar<<" Byte Values, "
+             <<"expected Version "<<Archive::VERSION<<" with "<<sizeof(T)<<std::endl;
+    return false;
+  }
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_s){
-      viewPos += glm::vec3(1.0, 0.0, 0.0);
-    }
+  //Blocks in the Layout of this Build, inside the File
+  const glm::ivec2 size = glm::ivec2(header->dim[0], header->dim[1]);
+  bool fits = size.x > 0 && size.y > 0 && size.y < header->stride &&
+              (int64_t)(size.x+2)*header->stride <= INT32_MAX && Field<T>::padded(size.y) == header->stride &&
+              header->trees <= map->size && header->ntrees <= (map->size - header->trees)/sizeof(Archive::Tree);
+  for(int k = 0; k < 4; k++)
+    fits = fits && header->blocks[k]%Archive::PAGE == 0 && header->blocks[k] <= map->size &&
+           Field<T>::footprint(size) <= map->size - header->blocks[k];
+  if(!fits){
+    std::cout<<"Snapshot "<<file<<" is truncated or has another Layout"<<std::endl;
+    return false;
+  }
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_d){
-      viewPos -= glm::vec3(0.0, 0.0, 1.0);
+  //Every Tree on a Map Cell
+  Field<T> layout;
+  layout.view(map->data + header->blocks[0], size);
+  const Archive::Tree* list = (const Archive::Tree*)(map->data + header->trees);
+  for(uint64_t n = 0; n < header->ntrees; n++)
+    if(!layout.contains(list[n].index)){
+      std::cout<<"Snapshot "<<file<<" has a Tree off the Map"<<std::endl;
+      return false;
     }
 
-	if (Tiny::event.keys.back().key.keysym.sym == SDLK_r) {
-		world.SEED = 0;
-		world.generate();
-	}
-
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_UP){
-      cameraPos += glm::vec3(0, 5, 0);
-      camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
-    }
+  //Generator State (Text)
+  std::mt19937 restored;
+  bool random = header->random <= map->size && header->nrandom <= map->size - header->random;
+  if(random){
+    std::istringstream state(std::string(map->data + header->random, header->nrandom));
+    random = (bool)(state>>restored);
+  }
+  if(!random){
+    std::cout<<"Snapshot "<<file<<" has no Generator State"<<std::endl;
+    return false;
+  }
 
-    if(Tiny::event.keys.back().key.keysym.sym == SDLK_DOWN){
-      cameraPos -= glm::vec3(0, 5, 0);
-      camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0,1,0)), glm::radians(rotation), glm::vec3(0,1,0));
+  std::cout<<"Loading World "<<file<<std::endl;
+  dim = size;
+  std::shared_ptr<Scratch> next = files();
+  auto place = [&](Field<T>& field, int k){
+    char* block = map->data + header->blocks[k];
+    if(next == NULL) field.view(block, dim);
+    else{
+      Scratch::resize(field, dim, next.get());
+      memcpy(field.block(), block, field.bytes());
     }
+  };
+  place(heightmap, 0);
+  place(waterpool, 1);
+  place(waterpath.restore(dim, header->calls, next.get()), 2);
+  place(plantdensity, 3);
+  mapping = (next == NULL)?map:NULL;
+
+  normals.release();                    //Everything Stale, see features()
+  lakes.release();
+  depressions.release();
+  scratch = next;
+
+  trees.clear();
+  for(uint64_t n = 0; n < header->ntrees; n++)
+    trees.push(Plant(glm::vec2(list[n].x, list[n].y), list[n].index, list[n].size));
+  roots.resize(dim, next.get());
+  roots.rebuild(trees, plantdensity);   //Counts are not stored
+  changed.resize(dim);
+
+  SEED = header->seed;
+  epoch = header->epoch;
+  scale = header->scale;
+  generator = restored;
+  std::cout<<"Seed: "<<SEED<<", Calls: "<<header->calls<<std::endl;
+  return true;
+}
 
-	if (Tiny::event.keys.back().key.keysym.sym == SDLK_LEFT) {
-		rotation += 4.5f;
-		camera = glm::rotate(camera, glm::radians(1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
-	}
-
-	if (Tiny::event.keys.back().key.keysym.sym == SDLK_RIGHT) {
-		rotation -= 4.5f;
-		camera = glm::rotate(camera, glm::radians(-1.5f), glm::vec3(0.0f, 1.0f, 0.0f));
-	}
-
-	//Adjust Stuff
-	if (rotation < 0.0) rotation = 360.0 + rotation;
-	else if (rotation > 360.0) rotation = rotation - 360.0;
-	camera = glm::rotate(glm::lookAt(cameraPos, lookPos, glm::vec3(0, 1, 0)), glm::radians(rotation), glm::vec3(0, 1, 0));
-
-    //Remove the guy
-    Tiny::event.keys.pop_back();
+//Copy the viewed Blocks into own Memory (or Scratch Files), unmap the File
+template<typename T>
+void World<T>::release(){
+  if(!mapping) return;
+  Field<T>* viewing[4] = {&heightmap, &waterpool, &waterpath.bake(), &plantdensity};
+  for(auto field: viewing){
+    const char* block = field->block();   //Mapped until the End
+    Scratch::resize(*field, dim, scratch.get());
+    memcpy(field->block(), block, field->bytes());
   }
-};
+  mapping.reset();
+}
 
-std::function<glm::vec4(double, double)> hydromap = [](double t1, double t2){
-  glm::vec4 color = glm::mix(glm::vec4(0.0, 0.0, 0.0, 1.0), glm::vec4(0.2, 0.5, 1.0, 1.0), t1);
-  if(t2 > 0.0) color = glm::mix(color, glm::vec4(0.15, 0.15, 0.45, 1.0), 1.0 - ease::langmuir(t2, 5.0));
-  return color;
-};
+//Scalar of the Renderer and the Batch Tool
+#ifdef HYDROLOGY_FLOAT
+using scalar = float;                   //Single Precision Build
+#else
+using scalar = double;
+#endif